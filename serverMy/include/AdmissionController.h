@@ -0,0 +1,70 @@
+#ifndef ADMISSIONCONTROLLER_H
+#define ADMISSIONCONTROLLER_H
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include "Task.h"
+
+// Ограничение нагрузки: число соединений, объем векторных данных
+// в обработке по всем сессиям и число сессий на один логин.
+// Сверх бюджета подключений accept сразу отвечает ERR.
+class AdmissionController {
+public:
+    struct Limits {
+        size_t maxConnections;
+        size_t maxInflightBytes;
+        size_t maxSessionsPerLogin;
+    };
+
+    // Резерв байтов векторных данных; освобождается в деструкторе
+    class BytesReservation {
+    private:
+        AdmissionController* owner;
+        size_t bytes;
+
+    public:
+        BytesReservation() : owner(nullptr), bytes(0) {}
+        ~BytesReservation() { release(); }
+
+        // Корутина ждет бюджет, не занимая поток исполнителя: освободить
+        // байты может сессия того же потока
+        Task<bool> acquire(AdmissionController* controller, size_t amount, int timeoutMs);
+        void release();
+
+        BytesReservation(const BytesReservation&) = delete;
+        BytesReservation& operator=(const BytesReservation&) = delete;
+    };
+
+private:
+    Limits limits;
+    mutable std::mutex admissionMutex;
+    std::condition_variable slotFreed;
+    std::condition_variable bytesFreed;
+
+    size_t connections;
+    size_t inflightBytes;
+    std::unordered_map<std::string, size_t> loginSessions;
+
+public:
+    explicit AdmissionController(const Limits& limits);
+
+    // Слот соединения: ждет освобождения не дольше timeoutMs (0 - не ждать)
+    bool acquireConnection(int timeoutMs);
+    void releaseConnection();
+
+    bool acquireLogin(const std::string& login);
+    void releaseLogin(const std::string& login);
+
+    // Бюджет байтов: вектор больше всего бюджета не поместится никогда
+    bool acquireBytes(size_t bytes, int timeoutMs);
+    void releaseBytes(size_t bytes);
+
+    size_t activeConnections() const;
+    size_t inflight() const;
+    const Limits& getLimits() const { return limits; }
+};
+
+#endif // ADMISSIONCONTROLLER_H
@@ -0,0 +1,83 @@
+#ifndef ASYNCSOCKET_H
+#define ASYNCSOCKET_H
+
+#include <coroutine>
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <openssl/types.h>
+#include "Executor.h"
+#include "Task.h"
+
+// Неблокирующий сокет с ожиданием через co_await.
+// В потоке исполнителя ожидание приостанавливает корутину до события epoll;
+// вне исполнителя (бенчмарки, отказ в приеме из потока accept) -
+// обычный блокирующий poll, и тот же код протокола работает синхронно.
+// Сокет не закрывается объектом - только снимается с epoll.
+// После startTls() все чтения и записи идут через TLS: при ядерном TLS (kTLS)
+// это по-прежнему recv/sendmsg по расшифрованным данным, иначе SSL_read/SSL_write.
+class AsyncSocket {
+public:
+    struct WaitAwaiter {
+        AsyncSocket& socket;
+        uint32_t events;
+        int timeoutMs;
+        Executor::Waiter waiter;
+        bool ready;
+
+        bool await_ready();
+        bool await_suspend(std::coroutine_handle<> handle);
+        // true - событие пришло, false - истек срок
+        bool await_resume() const { return ready || waiter.events != 0; }
+    };
+
+    explicit AsyncSocket(int fd);
+    ~AsyncSocket();
+
+    int get() const { return fd; }
+
+    // events - EPOLLIN/EPOLLOUT; timeoutMs < 0 - без срока
+    WaitAwaiter wait(uint32_t events, int timeoutMs);
+
+    // Одно чтение: > 0 байт, 0 - клиент закрыл соединение, < 0 - ошибка или срок
+    Task<ssize_t> receiveSome(void* buffer, size_t length, int timeoutMs);
+    // Ровно length байт; timeoutMs - сколько ждать каждую следующую порцию
+    Task<bool> receive(void* buffer, size_t length, int timeoutMs);
+    Task<bool> send(const void* buffer, size_t length);
+    // Ровно length байт и дескриптор, пришедший с ними через SCM_RIGHTS (Unix-сокет);
+    // receivedFd = -1, если дескриптора не было
+    Task<bool> receiveWithFd(void* buffer, size_t length, int& receivedFd, int timeoutMs);
+
+    // Запись без ожидания (для OutputQueue): байт записано или -1 с errno;
+    // при EAGAIN ждать событий writeWaitEvents()
+    ssize_t writeSome(const struct iovec* iov, int count);
+    uint32_t writeWaitEvents() const { return writeWants; }
+    // Расшифрованные данные уже лежат в буфере TLS и не видны через сокет
+    bool hasBufferedInput() const;
+
+    // Рукопожатие TLS на стороне сервера; объект владеет tls и освобождает его
+    Task<bool> startTls(SSL* tls, int timeoutMs);
+    bool isTls() const { return tls != nullptr; }
+    // Шифрование приема/отправки выполняет ядро
+    bool kernelTlsReceive() const { return kernelRecv; }
+    bool kernelTlsSend() const { return kernelSend; }
+
+    AsyncSocket(const AsyncSocket&) = delete;
+    AsyncSocket& operator=(const AsyncSocket&) = delete;
+
+private:
+    int fd;
+    Executor::Worker* worker;   // nullptr - блокирующий режим
+    bool registered;
+    SSL* tls;                   // nullptr - открытый текст
+    bool kernelRecv;
+    bool kernelSend;
+    uint32_t writeWants;
+
+    // Одно чтение без ожидания: байт прочитано, 0 - конец потока,
+    // -1 с errno; при EAGAIN ждать событий wants
+    ssize_t readSome(void* buffer, size_t length, uint32_t& wants);
+};
+
+#endif // ASYNCSOCKET_H
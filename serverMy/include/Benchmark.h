@@ -0,0 +1,32 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <cstdint>
+
+class AsyncSocket;
+
+// Встроенные бенчмарки (vcalc_server --bench NAME).
+// Прогоняют серверный код приема/суммирования через loopback-сокеты.
+class Benchmark {
+public:
+    static int run(const std::string& name);
+    static void printUsage();
+    
+private:
+    static int compression();
+    static int numa();
+    static int cache();
+    static int transport();
+    static int tls();
+    static int qos();
+    static int trace();
+    static int exact();
+    
+    // Пара соединенных TCP-сокетов через 127.0.0.1
+    static bool loopbackPair(int& clientFd, int& serverFd);
+    // Серверная сторона одного запроса OP_SUM через код сессии; false - ошибка протокола
+    static bool serveSum(AsyncSocket& socket, uint8_t flags, bool local, uint32_t vectors);
+};
+
+#endif // BENCHMARK_H
@@ -5,10 +5,13 @@
 #include <unordered_map>
 #include <mutex>
 #include <algorithm>
+#include <vector>
+#include "FairScheduler.h"
 
 class ClientDB {
 private:
     std::unordered_map<std::string, std::string> clients; // login -> password hash
+    std::unordered_map<std::string, QosProfile> profiles;  // только заданные явно
     mutable std::mutex dbMutex;  // mutable для const методов
     std::string filename;
     
@@ -20,6 +23,8 @@ public:
     
     bool clientExists(const std::string& login) const;
     bool verifyPassword(const std::string& login, const std::string& passwordHash) const;
+    // Класс обслуживания, вес и бюджет CPU; без записи в файле - STANDARD, вес 1
+    QosProfile getProfile(const std::string& login) const;
     
     // Генерация хэша для проверки
     static std::string generateHash(const std::string& salt, const std::string& password);
@@ -27,6 +32,12 @@ public:
     // Генерация случайной соли
     static std::string generateSalt();
     
+    // Хвост строки файла после логина: пароль[:класс[:вес[:cpu_мс]]].
+    // Поля QoS распознаются с конца, поэтому двоеточие в пароле допустимо;
+    // бюджет CPU больше окна планировщика - ошибка записи
+    static bool parseEntry(const std::string& entry, std::string& password,
+                           QosProfile& profile, bool& hasProfile);
+    
     // Добавление/удаление клиентов (для администрирования)
     bool addClient(const std::string& login, const std::string& password);
     bool removeClient(const std::string& login);
@@ -0,0 +1,49 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Режимы сжатия векторных данных (поле compression заголовка запроса).
+// Преобразование выбирается младшими битами, LZ4 включается флагом.
+enum class CompressionMode : uint8_t {
+    NONE = 0,
+    SHUFFLE = 1,    // перестановка байтов по значимости
+    XOR_DELTA = 2   // XOR с предыдущим элементом (как в Gorilla) + перестановка
+};
+
+// Кодирование блоков вектора: транспозиция байтов, XOR-дельта и
+// формат блока LZ4 (совместим с LZ4_compress_default/LZ4_decompress_safe).
+class Compression {
+public:
+    static const uint8_t TRANSFORM_MASK = 0x0F;
+    static const uint8_t FLAG_LZ4 = 0x10;
+
+    static bool isValidMode(uint8_t mode);
+
+    // Транспозиция: байт j элемента i переходит в позицию j * count + i
+    static void shuffle(const uint8_t* src, uint8_t* dst, size_t count, size_t elemSize);
+    static void unshuffle(const uint8_t* src, uint8_t* dst, size_t count, size_t elemSize);
+
+    // XOR-дельта на месте; prev переносит состояние между блоками вектора
+    static void xorDeltaEncode(uint8_t* data, size_t count, size_t elemSize, uint64_t& prev);
+    static void xorDeltaDecode(uint8_t* data, size_t count, size_t elemSize, uint64_t& prev);
+
+    // Блок LZ4. Сжатие возвращает размер результата (dst не меньше lz4Bound)
+    static size_t lz4Bound(size_t srcSize);
+    static size_t lz4Compress(const uint8_t* src, size_t srcSize, uint8_t* dst);
+    // Распаковка с проверкой границ: true, только если получено ровно dstSize байт
+    static bool lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+
+    // Полное кодирование блока на стороне клиента (используется бенчмарком).
+    // Если LZ4 не дает выигрыша, блок передается без сжатия.
+    static void encodeBlock(const uint8_t* raw, size_t rawBytes, size_t elemSize, uint8_t mode,
+                            uint64_t& prev, std::vector<uint8_t>& encoded);
+    // Декодирование блока на сервере: encoded -> raw (rawBytes байт)
+    static bool decodeBlock(const uint8_t* encoded, size_t encodedBytes, size_t rawBytes,
+                            size_t elemSize, uint8_t mode, uint64_t& prev,
+                            std::vector<uint8_t>& scratch, uint8_t* raw);
+};
+
+#endif // COMPRESSION_H
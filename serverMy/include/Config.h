@@ -2,6 +2,8 @@
 #define CONFIG_H
 
 #include <string>
+#include <cstdint>
+#include <cstddef>
 
 namespace Config {
     // Константы по умолчанию
@@ -19,6 +21,86 @@ namespace Config {
     const int BUFFER_SIZE = 4096;
     const std::string ERR_MSG = "ERR";
     const std::string OK_MSG = "OK";
+    
+    // Расширенный запрос: вместо количества векторов клиент шлет этот маркер,
+    // за ним заголовок с операцией, типом элементов и флагами
+    const uint32_t EXT_MAGIC = 0x58544556;  // "VETX"
+    const uint8_t OP_SUM = 0;
+    // Именованные векторы на сервере (VectorStore)
+    const uint8_t OP_CREATE = 1;
+    const uint8_t OP_APPEND = 2;
+    const uint8_t OP_UPDATE = 3;
+    const uint8_t OP_QUERY = 4;
+    const uint8_t OP_DROP = 5;
+    // Префиксные суммы и суммы скользящего окна (RangeSums)
+    const uint8_t OP_PREFIX = 6;
+    const uint8_t OP_WINDOW = 7;
+    const uint8_t FLAG_SATURATE = 0x01;     // целые: насыщение вместо ошибки
+    const uint8_t FLAG_BIG_ENDIAN = 0x02;   // размеры, элементы и ответы в big-endian
+    const uint8_t FLAG_SHARED_MEMORY = 0x04; // OP_SUM: векторы в общей памяти (SharedRegion)
+    const uint8_t FLAG_EXACT = 0x08;        // OP_SUM, float32/float64: точная сумма с одним округлением
+    
+    // Максимальный размер одного вектора; больше - ошибка OVERSIZE,
+    // а не попытка выделить память под объявленный клиентом размер
+    const size_t MAX_VECTOR_BYTES = 1024u * 1024 * 1024;
+    
+    // Сжатые векторы передаются блоками не больше этого размера (до распаковки)
+    const int COMPRESSION_BLOCK_SIZE = 64 * 1024;
+    
+    // Контроль нагрузки
+    const int DEFAULT_MAX_CONNECTIONS = 256;
+    const int DEFAULT_MAX_INFLIGHT_MB = 1024;        // векторные данные всех сессий
+    const int DEFAULT_MAX_SESSIONS_PER_LOGIN = 64;
+    const int ADMISSION_BYTES_WAIT_MS = 5000; // сколько сессия ждет бюджет памяти
+    const int ADMISSION_RETRY_MS = 5;         // шаг повторной попытки при ожидании бюджета
+    
+    // Остановка: сколько активные сессии могут дорабатывать после сигнала
+    const int DEFAULT_DRAIN_TIMEOUT_SEC = 30;
+    
+    // NUMA: сессия идет на узел CPU, принявшего пакеты соединения, пока
+    // на нем не больше чем на столько сессий больше, чем на самом свободном
+    const size_t NUMA_STEER_SLACK = 4;
+    
+    // Хранилище именованных векторов: блоки по строкам кэша,
+    // квота памяти на логин
+    const size_t CACHE_LINE_SIZE = 64;
+    const size_t STORE_CHUNK_ELEMENTS = 8192;   // 64 КБ double в блоке
+    const size_t STORE_MAX_NAME_LENGTH = 64;
+    const int DEFAULT_STORE_QUOTA_MB = 64;
+    const int DEFAULT_SNAPSHOT_INTERVAL_SEC = 300;  // 0 - снимок только при остановке
+    
+    // Кэш результатов: векторы меньше порога считаются заново - хэш
+    // и поиск в кэше дороже суммы (порог по --bench cache)
+    const size_t RESULT_CACHE_MIN_BYTES = 2048;
+    const int RESULT_CACHE_STATS_INTERVAL_SEC = 60;
+    
+    // Общая память клиента: предел размера отображаемого региона.
+    // Память принадлежит клиенту, сервер тратит на нее только адресное пространство
+    const uint64_t SHM_MAX_REGION_BYTES = 64ull * 1024 * 1024 * 1024;
+    
+    // TLS: рукопожатие, не уложившееся в срок, обрывается
+    // до аутентификации и не держит слот подключения
+    const int TLS_HANDSHAKE_TIMEOUT_MS = 10000;
+    
+    // Результаты префиксных и оконных сумм уходят пакетами по столько значений
+    const size_t RANGE_BATCH_RESULTS = 4096;
+    
+    // Планировщик вычислений: квант CPU на единицу веса логина за визит DRR,
+    // сколько поток подряд возобновляет сессии, не проверяя сокеты,
+    // и окно, в котором расходуется бюджет CPU логина
+    const int SCHED_QUANTUM_US = 250;
+    const int SCHED_DISPATCH_SLICE_US = 1000;
+    const int SCHED_BUDGET_WINDOW_MS = 1000;
+    const uint32_t SCHED_MAX_WEIGHT = 1000;
+    
+    // Бортовой самописец: последние события этапов каждого потока
+    // (степень двойки; ~48 байт на событие) и файл дампа по SIGUSR1 -
+    // по умолчанию в каталоге журнала, а не в общем /tmp
+    const size_t TRACE_RING_EVENTS = 8192;
+    const std::string DEFAULT_TRACE_FILE_NAME = "vcalc_trace.json";
+    
+    // Очередь ответов: при превышении объема накопленное сбрасывается
+    const int OUTPUT_QUEUE_LIMIT = 64 * 1024;
 }
 
 #endif // CONFIG_H
@@ -0,0 +1,46 @@
+#ifndef EXACTSUM_H
+#define EXACTSUM_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Точная сумма float32/float64 (суперсумматор Нила, "large + small";
+// блоки с узким разбросом порядков - векторным извлечением по уровням):
+// каждое слагаемое учитывается без округления, итог один раз округляется
+// до ближайшего double (к четному). Результат не зависит ни от порядка
+// элементов, ни от разбиения на части: частичные суммы складываются
+// через merge тоже точно.
+// Без конструктора, как SumState: перед использованием - clear().
+class ExactSum {
+public:
+    void clear();
+
+    void add(const double* data, size_t count);
+    void add(const float* data, size_t count);
+    void add(double value);
+    void merge(const ExactSum& other);
+
+    // Правильно округленный итог; NaN, если среди слагаемых NaN или +inf и -inf вместе
+    double round() const;
+
+private:
+    // Цифры по 32 бита в int64: запас под переносы на 2^31 прибавлений.
+    // 67 цифр покрывают все double от 2^-1074 и переносы суммы 2^32 слагаемых
+    static const int CHUNK_BITS = 32;
+    static const int CHUNKS = 67;
+
+    int64_t chunks[CHUNKS];   // значение - сумма chunks[i] * 2^(32i - 1074)
+    uint32_t pending;         // прибавлений с последней нормализации
+    bool nan;
+    bool positiveInf;
+    bool negativeInf;
+
+    // magnitude * 2^(position - 1074) со знаком
+    void addScaled(uint64_t magnitude, int position, bool negative);
+    static void normalize(int64_t* digits);
+    // Блок до 2048 элементов: по уровням, если разброс порядков узкий,
+    // иначе через таблицу порядков
+    void addBlock(const double* block, size_t length);
+};
+
+#endif // EXACTSUM_H
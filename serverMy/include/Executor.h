@@ -0,0 +1,106 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <coroutine>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include "Task.h"
+#include "FairScheduler.h"
+
+// Исполнитель корутин сессий: несколько потоков, у каждого свой epoll.
+// Сессия закреплена за одним потоком и выполняется только в нем;
+// пока она ждет сокет, поток обслуживает остальные сессии.
+// Вместо потока на клиента - кадр корутины на клиента.
+// Между проверками сокетов поток отдает ходы сессиям через FairScheduler.
+class Executor {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // Приостановленная корутина, ждущая события fd и/или срока
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        int fd;             // -1 - только срок (пауза)
+        uint32_t events;    // сработавшие события epoll, 0 - истек срок
+        bool* registered;   // признак fd в epoll у его владельца (из watch)
+        bool timed;
+        std::multimap<Clock::time_point, Waiter*>::iterator timer;
+    };
+
+    class Worker {
+    public:
+        ~Worker();
+
+        // Ждать событий fd однократно (EPOLLONESHOT); registered - fd уже в epoll.
+        // timeoutMs < 0 - без срока. false - fd не удалось поставить в epoll
+        bool watch(Waiter& waiter, uint32_t events, bool& registered, int timeoutMs);
+        void sleep(Waiter& waiter, int timeoutMs);
+        void forget(int fd);
+
+        size_t getIndex() const { return index; }
+        FairScheduler& getScheduler() { return scheduler; }
+
+    private:
+        friend class Executor;
+
+        size_t index;
+        int epollFd;
+        int wakeFd;
+        std::thread thread;
+        std::mutex incomingMutex;
+        std::vector<std::coroutine_handle<>> incoming;  // запущены из других потоков
+        std::multimap<Clock::time_point, Waiter*> timers;
+        std::atomic<bool> stopping;
+        FairScheduler scheduler;    // очередь вычислений сессий этого потока
+
+        Worker();
+
+        void post(std::coroutine_handle<> handle);
+        void run();
+        int nextTimeoutMs() const;
+        void expireTimers();
+    };
+
+    // Пауза корутины; вне исполнителя - обычный sleep потока
+    struct SleepAwaiter {
+        int timeoutMs;
+        Worker* worker;
+        Waiter waiter;
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const {}
+    };
+
+    explicit Executor(size_t threads);
+    ~Executor();
+
+    // onStart вызывается в каждом потоке до первой сессии (привязка к CPU/узлу)
+    bool start(const std::function<void(size_t)>& onStart);
+    // Запуск корутины в потоке worker; кадр освобождается по ее завершении
+    void spawn(size_t worker, Task<void> task);
+    // Потоки выходят после текущей итерации; незавершенные сессии не возобновляются
+    void stop();
+
+    size_t size() const { return workers.size(); }
+
+    // Поток исполнителя, в котором выполняется вызывающий код; nullptr - чужой поток
+    static Worker* current();
+    static SleepAwaiter sleep(int timeoutMs);
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+private:
+    std::vector<std::unique_ptr<Worker>> workers;
+    bool started;
+};
+
+#endif // EXECUTOR_H
@@ -0,0 +1,94 @@
+#ifndef FAIRSCHEDULER_H
+#define FAIRSCHEDULER_H
+
+#include <coroutine>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+// Класс обслуживания логина (clients.conf: login:password[:class[:weight[:cpu_ms]]])
+enum class QosClass : uint8_t {
+    INTERACTIVE = 0,  // короткие запросы: обслуживаются раньше остальных
+    STANDARD = 1,
+    BULK = 2          // потоковые задания: только когда нет более срочной работы
+};
+
+struct QosProfile {
+    QosClass qos;
+    uint32_t weight;        // доля логина внутри класса
+    uint32_t cpuMsPerSec;   // бюджет CPU логина на все сессии, мс в секунду; 0 - без ограничения
+
+    QosProfile() : qos(QosClass::STANDARD), weight(1), cpuMsPerSec(0) {}
+};
+
+// Справедливое распределение вычислений между логинами в одном потоке
+// исполнителя. Получив данные вектора, перед вычислением сессия встает
+// в очередь своего логина (turn) и продолжается, когда до нее дойдет
+// планировщик - так вычисление идет из dispatch и попадает в стоимость хода:
+// классы - строгий приоритет, логины внутри класса - deficit round robin
+// по весу. Стоимость хода - фактическое время CPU от возобновления сессии
+// до ее следующей остановки, им же расходуется бюджет логина.
+// Один планировщик на поток исполнителя; обращаться только из этого потока.
+class FairScheduler {
+public:
+    struct Account;
+
+    // Очередь сессий одного логина в этом потоке
+    struct Flow {
+        FairScheduler* owner;
+        std::string login;
+        QosProfile profile;
+        std::shared_ptr<Account> account;
+        std::deque<std::coroutine_handle<>> waiting;
+        int64_t deficitNs;
+        size_t sessions;
+        bool active;    // стоит в списке своего класса
+        bool running;   // возобновлен планировщиком прямо сейчас
+    };
+
+    struct TurnAwaiter {
+        Flow* flow;
+
+        bool await_ready() const;
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const {}
+    };
+
+    FairScheduler();
+    ~FairScheduler();
+
+    Flow* attach(const std::string& login, const QosProfile& profile);
+    void detach(Flow* flow);
+
+    // Очередь вычислений; вне исполнителя или без flow - сразу
+    static TurnAwaiter turn(Flow* flow);
+    // Планировщик потока, в котором выполняется вызывающий код; nullptr - чужой поток
+    static FairScheduler* current();
+
+    // Возобновляет ожидающие сессии не дольше SCHED_DISPATCH_SLICE_US
+    void dispatch();
+    // Сколько можно ждать событий: 0 - есть готовые ходы, -1 - очередь пуста,
+    // иначе мс до пополнения бюджета первого из исчерпавших его логинов
+    int idleTimeoutMs() const;
+
+    static bool parseClass(const std::string& name, QosClass& qos);
+    static const char* className(QosClass qos);
+
+    FairScheduler(const FairScheduler&) = delete;
+    FairScheduler& operator=(const FairScheduler&) = delete;
+
+private:
+    static const int CLASS_COUNT = 3;
+
+    std::unordered_map<std::string, std::unique_ptr<Flow>> flows;
+    std::deque<Flow*> active[CLASS_COUNT];
+
+    void activate(Flow* flow);
+    // Один визит DRR в голову списка класса; false - в классе нечего запускать
+    bool serveClass(int qos, int64_t now);
+    void release(Flow* flow);
+};
+
+#endif // FAIRSCHEDULER_H
@@ -0,0 +1,113 @@
+#ifndef FLIGHTRECORDER_H
+#define FLIGHTRECORDER_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <ctime>
+
+// Точки USDT (provider vcalc) для bpftrace/perf/SystemTap: без подключенного
+// трассировщика - одна инструкция nop. Без sys/sdt.h аргументы
+// только проверяются компилятором и не вычисляются
+#ifdef VCALC_WITH_USDT
+#include <sys/sdt.h>
+#define VCALC_PROBE(name, ...) STAP_PROBEV(vcalc, name, __VA_ARGS__)
+#else
+#define VCALC_PROBE(name, ...) ((void)sizeof(vcalcProbeArgs(__VA_ARGS__)))
+template<typename... Args>
+inline int vcalcProbeArgs(const Args&...) { return 0; }
+#endif
+
+// Этапы сессии; номер этапа - аргумент точек stage__begin/stage__end
+enum class TraceStage : uint8_t {
+    ACCEPT = 0,          // accept и допуск, поток приема подключений
+    SESSION = 1,         // вся сессия, от начала обработки до закрытия
+    TLS_HANDSHAKE = 2,
+    AUTH = 3,            // аутентификация целиком
+    RECEIVE_LOGIN = 4,
+    RECEIVE_HASH = 5,
+    VERIFY_HASH = 6,     // SHA-1 от соли и пароля и сравнение
+    SCHEDULER_WAIT = 7,  // очередь логина в планировщике потока
+    FLUSH = 8,           // отправка накопленных ответов
+    RECEIVE_VECTOR = 9,  // данные вектора; для сжатого - прием вместе с распаковкой
+    COMPUTE = 10         // суммирование
+};
+
+struct TraceEvent {
+    uint64_t startNs;     // CLOCK_MONOTONIC
+    uint64_t durationNs;
+    uint64_t session;     // номер подключения; 0 - вне сессии
+    uint64_t arg;         // байты этапа или другой параметр
+    uint32_t thread;      // tid потока, записавшего событие
+    TraceStage stage;
+};
+
+// Бортовой самописец: у каждого потока свое кольцо последних
+// Config::TRACE_RING_EVENTS событий. Запись - без блокировок и системных
+// вызовов; чтение (snapshot, dump) идет параллельно и пропускает
+// слоты, которые в этот момент перезаписываются.
+class FlightRecorder {
+public:
+    static uint64_t now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    // Начало этапа: время для end; 0 - запись выключена
+    static uint64_t begin(TraceStage stage, uint64_t session) {
+        VCALC_PROBE(stage__begin, static_cast<int>(stage), session);
+        return enabled.load(std::memory_order_relaxed) ? now() : 0;
+    }
+
+    static void end(TraceStage stage, uint64_t session, uint64_t startNs, uint64_t arg = 0) {
+        if (startNs == 0) {
+            VCALC_PROBE(stage__end, static_cast<int>(stage), session, 0, arg);
+            return;
+        }
+        uint64_t durationNs = now() - startNs;
+        VCALC_PROBE(stage__end, static_cast<int>(stage), session, durationNs, arg);
+        record(stage, session, startNs, durationNs, arg);
+    }
+
+    // Номер нового подключения для событий его этапов
+    static uint64_t newSession();
+    static void setEnabled(bool value);
+
+    // События всех потоков по возрастанию начала
+    static std::vector<TraceEvent> snapshot();
+    // Chrome trace JSON (chrome://tracing, Perfetto): дорожка на каждую сессию.
+    // Пишется во временный файл и переименовывается; возвращает число событий, -1 - ошибка
+    static long dump(const std::string& path);
+
+    static const char* stageName(TraceStage stage);
+
+private:
+    static std::atomic<bool> enabled;
+
+    static void record(TraceStage stage, uint64_t session, uint64_t startNs,
+                       uint64_t durationNs, uint64_t arg);
+};
+
+// Этап на всю область видимости, в том числе через co_await:
+// сессия не покидает своего потока исполнителя
+class TraceSpan {
+public:
+    TraceSpan(TraceStage stage, uint64_t session)
+        : stage(stage), session(session), arg(0), startNs(FlightRecorder::begin(stage, session)) {}
+    ~TraceSpan() { FlightRecorder::end(stage, session, startNs, arg); }
+
+    void setArg(uint64_t value) { arg = value; }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    TraceStage stage;
+    uint64_t session;
+    uint64_t arg;
+    uint64_t startNs;
+};
+
+#endif // FLIGHTRECORDER_H
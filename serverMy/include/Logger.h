@@ -28,6 +28,7 @@ public:
     bool initialize();
     void log(LogLevel level, const std::string& message, const std::string& params = "");
     void logError(bool isCritical, const std::string& message, const std::string& params = "");
+    void flush();
     
     // Запрет копирования
     Logger(const Logger&) = delete;
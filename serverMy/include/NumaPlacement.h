@@ -0,0 +1,35 @@
+#ifndef NUMAPLACEMENT_H
+#define NUMAPLACEMENT_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Размещение потоков и памяти по NUMA-узлам.
+// Топология читается из sysfs. При сборке с libnuma (VCALC_WITH_NUMA)
+// память выделяется прямо на нужном узле, а поток получает локальную
+// политику выделения; без нее локальность обеспечивают привязка потока
+// к CPU узла и размещение страниц при первом обращении (first-touch).
+class NumaPlacement {
+public:
+    // Список CPU в формате sysfs/taskset: "0-3,8,10-11"
+    static bool parseCpuList(const std::string& text, std::vector<int>& cpus);
+
+    static bool libnumaAvailable();
+    static int nodeCount();
+    static const std::vector<int>& nodeCpus(int node);
+    static int nodeOfCpu(int cpu);
+    static std::vector<int> onlineCpus();
+
+    // Привязка текущего потока к набору CPU
+    static bool pinThread(const std::vector<int>& cpus);
+
+    // Поток на CPU узла (только из allowed, если задан) с локальной памятью
+    static bool bindThreadToNode(int node, const std::vector<int>& allowed);
+
+    // Память на узле; освобождать только через freeOnNode
+    static void* allocateOnNode(size_t bytes, int node);
+    static void freeOnNode(void* memory, size_t bytes);
+};
+
+#endif // NUMAPLACEMENT_H
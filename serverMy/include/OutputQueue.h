@@ -0,0 +1,68 @@
+#ifndef OUTPUTQUEUE_H
+#define OUTPUTQUEUE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Task.h"
+
+class AsyncSocket;
+
+// Очередь исходящих ответов одного соединения.
+// Мелкие ответы (соль, OK/ERR, суммы) накапливаются и уходят одним
+// writev/sendmsg на границе протокола, а не отдельным send на каждые 8 байт.
+// Постановка в очередь не ждет сокет: при переполнении очереди отправляется
+// то, что влезает, а дождаться остального - co_await drain()/flush().
+class OutputQueue {
+private:
+    struct Segment {
+        const uint8_t* external;  // nullptr - данные лежат в storage
+        size_t offset;
+        size_t length;
+    };
+
+    AsyncSocket& socket;
+    std::vector<uint8_t> storage;
+    std::vector<Segment> segments;
+    size_t pending;
+    bool bulk;
+    bool corked;
+
+    // Отправка без ожидания; blocked - буфер сокета заполнен, часть осталась в очереди
+    bool writeAvailable(bool& blocked);
+    bool setCork(bool enable);
+
+public:
+    explicit OutputQueue(AsyncSocket& socket);
+
+    // Копирует данные в очередь; false - ошибка сокета
+    bool enqueue(const void* data, size_t length);
+    // Ставит в очередь внешний буфер без копирования;
+    // буфер должен жить до ближайшего flush()
+    bool enqueueRef(const void* data, size_t length);
+
+    // Клиент не успевает читать: очередь не ушла в сокет целиком
+    bool congested() const;
+    // Дождаться отправки накопленного (пробка, если есть, остается)
+    Task<bool> drain();
+    // Граница протокола: отправить всё накопленное немедленно
+    Task<bool> flush();
+    // Поставить в очередь и сразу отправить (одиночный ответ, критичный к задержке)
+    Task<bool> sendNow(const void* data, size_t length);
+
+    // Поток результатов: промежуточные сбросы идут под TCP_CORK
+    // полными сегментами, хвост выталкивается на flush()
+    void beginBulk();
+    Task<bool> endBulk();
+
+    bool setNoDelay(bool enable);
+
+    size_t pendingBytes() const { return pending; }
+    bool hasPending() const { return pending > 0; }
+
+    // Запрет копирования
+    OutputQueue(const OutputQueue&) = delete;
+    OutputQueue& operator=(const OutputQueue&) = delete;
+};
+
+#endif // OUTPUTQUEUE_H
@@ -5,31 +5,104 @@
 #include <vector>
 #include <cstdint>
 #include <algorithm>
+#include "VectorProcessor.h"
+#include "Session.h"
+#include "AdmissionController.h"
+#include "Task.h"
+
+class OutputQueue;
+class AsyncSocket;
+class Logger;
 
 class Protocol {
 public:
+    // Заголовок расширенного запроса (следует за Config::EXT_MAGIC)
+    struct RequestHeader {
+        uint8_t op;
+        uint8_t elementType;
+        uint8_t flags;
+        uint8_t compression;    // CompressionMode | Compression::FLAG_LZ4
+        uint32_t numVectors;
+    };
+    
+    // Буферы распаковки, переиспользуемые между векторами сессии
+    struct DecodeBuffers {
+        std::vector<uint8_t> encoded;
+        std::vector<uint8_t> scratch;
+        std::vector<uint8_t> block;
+    };
+    
     // Аутентификация
-    static bool sendSalt(int clientSocket, const std::string& salt);
-    static bool sendError(int clientSocket);
-    static bool sendOk(int clientSocket);
+    static Task<bool> sendSalt(OutputQueue& out, const std::string& salt);
+    static Task<bool> sendError(OutputQueue& out);
+    static Task<bool> sendOk(OutputQueue& out);
     
-    static bool receiveLogin(int clientSocket, std::string& login);
-    static bool receiveHash(int clientSocket, std::string& hash);
+    static Task<bool> receiveLogin(AsyncSocket& clientSocket, std::string& login);
+    static Task<bool> receiveHash(AsyncSocket& clientSocket, std::string& hash);
     
     // Работа с векторами (бинарный формат)
     static bool sendVectorResults(int clientSocket, 
                                   const std::vector<double>& results);
-    static bool receiveVectorData(int clientSocket, 
-                                  std::vector<uint8_t>& binaryData);
+    static Task<bool> receiveVectorData(Session& session, size_t& bytesReceived);
+    static Task<bool> receiveTypedVectors(Session& session, const RequestHeader& header,
+                                          size_t& bytesReceived);
+    // Операции над именованными векторами (Config::OP_CREATE ... OP_DROP):
+    // после OK клиент шлет [u8 длина имени][имя], затем данные операции
+    static Task<bool> receiveStoreRequest(Session& session, const RequestHeader& header,
+                                          size_t& bytesReceived);
+    // Префиксные суммы (OP_PREFIX) и окна (OP_WINDOW: после OK [u32 ширина][u32 шаг]);
+    // на каждый вектор [u8 статус][u32 число сумм], затем суммы пакетами
+    static Task<bool> receiveRangeRequest(Session& session, const RequestHeader& header,
+                                          size_t& bytesReceived);
+    // Векторы в общей памяти клиента (Config::FLAG_SHARED_MEMORY, только Unix-сокет):
+    // после OK клиент шлет [u64 размер региона] с memfd в SCM_RIGHTS, после второго OK -
+    // numVectors дескрипторов [u64 смещение][u32 число элементов]; ответы как у OP_SUM
+    static Task<bool> receiveSharedVectors(Session& session, const RequestHeader& header,
+                                           size_t& bytesReceived);
+    // Сжатый вектор принимается блоками и сразу суммируется,
+    // целиком в памяти не собирается
+    // При ошибке в данных status получает MALFORMED (и предупреждение в logger,
+    // если он задан), при ошибке сокета остается OK.
+    // Распаковка и сумма каждого блока - после хода в очереди flow
+    static Task<bool> receiveCompressedVector(AsyncSocket& clientSocket, uint32_t vectorSize,
+                                              uint8_t compression, ByteOrder order,
+                                              VectorProcessor::SumState& state,
+                                              DecodeBuffers& buffers, ResultStatus& status,
+                                              Logger* logger = nullptr,
+                                              FairScheduler::Flow* flow = nullptr);
     
-    // Вспомогательные функции
+    // Вспомогательные функции; sendAll/recvAll - блокирующие, для сокетов вне сессий
     static bool sendAll(int socket, const void* buffer, size_t length);
     static bool recvAll(int socket, void* buffer, size_t length);
+    static bool inputPending(int socket);
     static std::string binaryToHex(const std::vector<uint8_t>& data);
     static std::vector<uint8_t> hexToBinary(const std::string& hex);
     
 private:
     static const int SEND_RECV_TIMEOUT = 10; // секунд
+    static const int AUTH_TIMEOUT_MS = 5000;    // логин и хэш
+    static const int RECV_TIMEOUT_MS = 30000;   // простой между порциями данных
+    
+    // Между векторами: разгрузить переполненную очередь и отдать ответы,
+    // если клиент ничего не прислал
+    static Task<bool> settleOutput(Session& session);
+    // Ход в очереди логина - когда данные уже получены, прямо перед вычислением:
+    // все до следующей остановки сессии выполняется из FairScheduler::dispatch
+    // и списывается с дефицита и бюджета CPU логина
+    static Task<void> awaitTurn(Session& session);
+    // Предупреждение в журнал сервера; без журнала (бенчмарки) - ничего
+    static void logWarning(Logger* logger, const std::string& message, const std::string& params);
+    // Ответ на вектор OP_SUM: [u8 статус][8 байт суммы в порядке клиента]
+    static bool queueTypedReply(OutputQueue& out, ElementType type, const VectorProcessor::TypedSum& sum,
+                                ByteOrder order);
+    
+    // Пакет элементов для хранилища и диапазонных сумм: [u32 count][элементы] -> double в порядке хоста.
+    // Бюджет под raw и values остается в reservation - вызывающий освобождает его после операции.
+    // false - ошибка сокета; OVERSIZE/BUSY в status - поток дальше не читается
+    static Task<bool> receiveStoreElements(Session& session, ElementType type, ByteOrder order,
+                                           std::vector<uint8_t>& raw, std::vector<double>& values,
+                                           AdmissionController::BytesReservation& reservation,
+                                           ResultStatus& status, size_t& bytesReceived);
 };
 
 #endif // PROTOCOL_H
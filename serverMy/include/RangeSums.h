@@ -0,0 +1,49 @@
+#ifndef RANGESUMS_H
+#define RANGESUMS_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Префиксные суммы и суммы скользящего окна за один проход по вектору.
+// Клиент присылает вектор один раз вместо отдельного среза на каждый
+// диапазон: трафик O(n) вместо O(n*k).
+//
+// Каждая префиксная сумма - пара (sum, compensation) по Ноймайеру.
+// Окно [a, a+W) считается как разность двух таких пар, старшие и младшие
+// части вычитаются отдельно: ошибка порядка eps*|сумма окна|, а не
+// eps*|префикс|, как при вычитании округленных префиксов.
+class RangeSums {
+public:
+    struct Accumulator {
+        double sum;
+        double compensation;
+    };
+
+    // Окна шириной width с шагом stride по вектору из count элементов:
+    // позиция ведущего и замыкающего края, префиксы на них
+    struct WindowCursor {
+        const double* data;
+        uint64_t count;
+        uint32_t width;
+        uint32_t stride;
+        uint64_t emitted;   // сколько окон уже выдано
+        uint64_t lead;      // элементов учтено в leadSum
+        uint64_t trail;     // элементов учтено в trailSum
+        Accumulator leadSum;
+        Accumulator trailSum;
+    };
+
+    static void reset(Accumulator& acc);
+
+    // Префиксные суммы count элементов, продолжая накопленное в acc:
+    // out[i] = сумма всех элементов до data[i] включительно
+    static void prefix(Accumulator& acc, const double* data, size_t count, double* out);
+
+    static uint64_t windowCount(uint64_t count, uint32_t width, uint32_t stride);
+    static void beginWindows(WindowCursor& cursor, const double* data, uint64_t count,
+                             uint32_t width, uint32_t stride);
+    // Следующие окна, не больше maxOut; 0 - окна кончились
+    static size_t nextWindows(WindowCursor& cursor, double* out, size_t maxOut);
+};
+
+#endif // RANGESUMS_H
@@ -0,0 +1,91 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "VectorProcessor.h"
+
+// Кэш результатов для повторяющихся векторов (эталонные наборы и т.п.).
+// Ключ - 64-битный хэш содержимого (XXH64) вместе с длиной, видом
+// суммирования и логином; LRU разбит на шарды со своими мьютексами, чтобы
+// сессии не выстраивались в очередь на одной блокировке.
+// Хэш не криптографический, поэтому у каждого логина свое пространство
+// ключей, а зерно хэша - случайный секрет процесса: подобранный под
+// коллизию вектор может испортить только результаты своего же логина.
+class ResultCache {
+public:
+    struct Key {
+        uint64_t hash;
+        uint64_t scope;  // хэш логина: записи разных логинов не совпадают
+        uint64_t bytes;
+        uint32_t kind;   // тип элементов и флаги, влияющие на результат
+
+        bool operator==(const Key& other) const {
+            return hash == other.hash && scope == other.scope && bytes == other.bytes &&
+                   kind == other.kind;
+        }
+    };
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t bytesSaved;  // объем векторов, сумма которых взята из кэша
+        size_t entries;
+    };
+
+    explicit ResultCache(size_t capacity);
+
+    // Вид суммирования: тип и значимые флаги расширенного запроса
+    static uint32_t kindOf(ElementType type, uint8_t flags);
+
+    // Окупается только там, где сумма дороже хэша (--bench cache):
+    // компенсированная сумма float64 от RESULT_CACHE_MIN_BYTES
+    static bool worthCaching(ElementType type, size_t bytes);
+
+    static uint64_t hash(const void* data, size_t length, uint64_t seed = 0);
+    // Ключ вектора логина; зерно - секрет этого экземпляра кэша
+    Key makeKey(uint32_t kind, const std::string& login, const void* data, size_t length) const;
+
+    bool lookup(const Key& key, VectorProcessor::TypedSum& result);
+    void insert(const Key& key, const VectorProcessor::TypedSum& result);
+
+    Stats stats() const;
+    size_t getCapacity() const { return capacity; }
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return static_cast<size_t>(key.hash); }
+    };
+
+    typedef std::list<std::pair<Key, VectorProcessor::TypedSum>> Entries;
+
+    struct Shard {
+        std::mutex mutex;
+        size_t capacity;  // доля общего лимита; сумма по шардам - ровно capacity
+        Entries lru;  // в начале - последние использованные
+        std::unordered_map<Key, Entries::iterator, KeyHash> index;
+    };
+
+    static const size_t SHARD_COUNT = 16;
+
+    size_t capacity;
+    size_t shardCount;  // не больше capacity: у каждого шарда хотя бы одна запись
+    uint64_t seed;
+    std::unique_ptr<Shard[]> shards;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> evictions;
+    std::atomic<uint64_t> bytesSaved;
+
+    Shard& shardFor(const Key& key) const;
+};
+
+#endif // RESULTCACHE_H
@@ -2,39 +2,148 @@
 #define SERVER_H
 
 #include <string>
+#include <cstdint>
 #include <atomic>
-#include <thread>
 #include <vector>
+#include <list>
+#include <mutex>
+#include <condition_variable>
 #include <memory>
+#include <sys/types.h>
+#include "AdmissionController.h"
+#include "Task.h"
 
 class Logger;
 class ClientDB;
+class OutputQueue;
+class ResultCache;
+class VectorStore;
+class Executor;
+class AsyncSocket;
+class TlsContext;
+struct Session;
 
 class Server {
 private:
+    // Сессия клиента; done выставляется под clientsMutex вместе с закрытием сокета,
+    // поэтому при остановке shutdown() не попадет в чужой переиспользованный fd
+    struct ClientHandle {
+        int socket;
+        bool done;
+        int node;       // NUMA-узел сессии, -1 - без привязки к узлу
+        size_t worker;  // поток исполнителя, в котором выполняется сессия
+        bool tls;       // принят на порту TLS
+        uint64_t traceId;  // номер подключения в событиях самописца
+    };
+    
     int port;
     int serverSocket;
+    int signalFd;   // SIGINT/SIGTERM через signalfd - без обработчика сигналов
+    int wakeFd;     // eventfd: stop() из любого потока будит цикл accept
+    int handoffSocket;  // управляющий Unix-сокет для передачи слушающего сокета
+    int unixSocket;     // слушающий Unix-сокет для клиентов на этом хосте, -1 - нет
+    ino_t unixInode;    // путь удаляется при остановке, только если он все еще наш
+    std::string unixPath;
+    int tlsPort;        // 0 - без TLS
+    int tlsSocket;
+    std::string tlsCertFile;
+    std::string tlsKeyFile;
+    std::unique_ptr<TlsContext> tlsContext;
+    pid_t upgradePid;
+    std::string handoffPath;
+    std::string takeoverPath;
+    std::vector<std::string> upgradeCommand;
+    int drainTimeoutSec;
+    // Размещение: CPU потоков сессий, CPU потока accept, распределение по узлам
+    std::vector<int> workerCpus;
+    int acceptorCpu;
+    bool numaSteering;
+    std::vector<size_t> nodeSessions;  // под clientsMutex
+    // Потоки исполнителя: узел каждого (-1 - любой) и число его сессий
+    size_t workerThreads;              // 0 - по числу разрешенных CPU
+    std::vector<int> workerNodes;
+    std::vector<size_t> workerSessions;  // под clientsMutex
+    std::unique_ptr<Executor> executor;
     std::atomic<bool> running;
+    bool drained;
     std::unique_ptr<Logger> logger;
     std::unique_ptr<ClientDB> clientDB;
+    std::unique_ptr<AdmissionController> admission;
+    std::unique_ptr<ResultCache> resultCache;  // nullptr - кэш выключен
+    std::unique_ptr<VectorStore> store;        // nullptr - именованные векторы выключены
+    std::string snapshotPath;                  // пусто - без снимков
+    int snapshotIntervalSec;
+    pid_t snapshotPid;                         // процесс, пишущий снимок
+    bool handedOff;                            // слушающий сокет передан новому процессу
+    std::string traceFile;                     // дамп самописца по SIGUSR1
     
-    std::vector<std::thread> clientThreads;
+    std::list<ClientHandle> clientSessions;
+    std::mutex clientsMutex;
+    std::condition_variable clientsChanged;
     
     bool initializeSocket();
+    bool initializeTls();
+    static int listenTcp(int listenPort, bool sharedPort);
+    bool initializeUnixSocket();
+    void closeUnixSocket();
+    void acceptClient(int listenSocket, bool tls);
+    bool initializeSignals();
+    bool acceptHandoff();
+    void spawnUpgrade();
     void cleanup();
-    void handleClient(int clientSocket);
-    void clientSession(int clientSocket);
+    void reapClients();
+    void initializePlacement();
+    int chooseNode(int clientSocket);
+    size_t chooseWorker(int node);
+    void placeWorker(size_t index);
+    void logCacheStats();
+    void loadSnapshot();
+    void startSnapshot();
+    void reportSnapshot(bool written);
+    void dumpTrace();
+    Task<void> runClient(ClientHandle* handle);
+    Task<void> handleClient(int clientSocket, bool tls, uint64_t traceId);
+    Task<void> clientSession(AsyncSocket& socket, OutputQueue& out, bool local, uint64_t traceId);
+    void rejectClient(int clientSocket, bool tls);
     
     // Аутентификация клиента
-    bool authenticateClient(int clientSocket, std::string& clientLogin);
+    Task<bool> authenticateClient(Session& session);
     
 public:
     Server(int port, const std::string& clientDbFile, const std::string& logFile);
     ~Server();
     
+    // Вызывать до start()
+    void setAdmissionLimits(const AdmissionController::Limits& limits);
+    void setDrainTimeout(int seconds);
+    // Обновление без простоя: управляющий сокет этого процесса, сокет старого
+    // процесса, у которого забрать слушающий сокет, и команда запуска для SIGUSR2
+    void setHandoffPath(const std::string& path);
+    void setTakeoverPath(const std::string& path);
+    void setUpgradeCommand(const std::vector<std::string>& command);
+    // Дополнительный слушающий Unix-сокет: без стека TCP, с передачей общей памяти
+    void setUnixPath(const std::string& path);
+    // Дополнительный порт с TLS; сертификат и ключ - PEM-файлы
+    void setTls(int port, const std::string& certFile, const std::string& keyFile);
+    // Пустой cpus - все CPU; acceptorCpu < 0 - поток accept не привязывается
+    void setCpuPlacement(const std::vector<int>& cpus, int acceptorCpu, bool numaSteering);
+    // Число потоков, между которыми распределяются сессии; 0 - по числу CPU
+    void setWorkerThreads(size_t threads);
+    // Кэш результатов повторяющихся векторов; 0 записей - выключен
+    void setResultCache(size_t entries);
+    // Квота памяти именованных векторов на логин; 0 - хранилище выключено
+    void setStoreQuota(size_t bytes);
+    // Снимок хранилища: загружается при старте, пишется периодически и при остановке
+    void setSnapshot(const std::string& path, int intervalSec);
+    // Куда SIGUSR1 пишет события бортового самописца (Chrome trace JSON)
+    void setTraceFile(const std::string& path);
+    
+    // Блокирует SIGINT/SIGTERM/SIGUSR1/SIGUSR2: вызывать из главного потока до создания других потоков
     bool initialize();
     void start();
+    // Безопасно вызывать из любого потока: только флаг и запись в eventfd
     void stop();
+    // Дожидается завершения сессий не дольше drainTimeout, затем обрывает оставшиеся
     void waitForStop();
     
     // Статистика
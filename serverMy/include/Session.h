@@ -0,0 +1,33 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <string>
+#include <cstdint>
+#include "FairScheduler.h"
+
+class AsyncSocket;
+class OutputQueue;
+class AdmissionController;
+class ResultCache;
+class VectorStore;
+class Logger;
+
+// Контекст клиентской сессии, передаваемый обработчикам протокола
+struct Session {
+    AsyncSocket& socket;
+    OutputQueue& out;
+    std::string login;
+    AdmissionController* admission;  // nullptr - без ограничений
+    ResultCache* cache;              // nullptr - кэш результатов выключен
+    VectorStore* store;              // nullptr - именованные векторы недоступны
+    bool local;                      // Unix-сокет: клиент может передать общую память
+    FairScheduler::Flow* flow;       // очередь логина в планировщике; nullptr - без очереди
+    uint64_t traceId;                // номер подключения в событиях самописца; 0 - вне сервера
+    Logger* logger;                  // журнал сервера; nullptr - сообщения не пишутся
+    
+    Session(AsyncSocket& socket, OutputQueue& out) 
+        : socket(socket), out(out), admission(nullptr), cache(nullptr), store(nullptr), local(false),
+          flow(nullptr), traceId(0), logger(nullptr) {}
+};
+
+#endif // SESSION_H
@@ -0,0 +1,35 @@
+#ifndef SHAREDREGION_H
+#define SHAREDREGION_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Общая память клиента на том же хосте: memfd, переданный через SCM_RIGHTS
+// по Unix-сокету. Клиент пишет векторы в регион и присылает дескрипторы
+// [u64 offset][u32 count], сервер суммирует прямо из отображения -
+// данные не проходят через сокет и не копируются ядром.
+// Регион клиент использует как кольцо: область вектора можно
+// перезаписать, как только пришел ответ на него.
+class SharedRegion {
+public:
+    struct Mapping {
+        const uint8_t* data;
+        uint64_t size;
+    };
+
+    // Отображение только на чтение. memfd должен быть запечатан от уменьшения
+    // (F_SEAL_SHRINK): укоротив файл, клиент уронил бы сервер по SIGBUS.
+    // error - причина отказа: размер, печать или ошибка mmap
+    static bool map(int fd, uint64_t size, Mapping& mapping, std::string& error);
+    static void unmap(Mapping& mapping);
+
+    // Элементы вектора в регионе; nullptr - дескриптор выходит за границы
+    // региона или не выровнен по размеру элемента
+    static const uint8_t* span(const Mapping& mapping, uint64_t offset, uint32_t count, size_t elemSize);
+
+    // Сторона клиента: memfd размера size с печатью F_SEAL_SHRINK, -1 - ошибка
+    static int create(uint64_t size);
+};
+
+#endif // SHAREDREGION_H
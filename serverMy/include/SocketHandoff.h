@@ -0,0 +1,34 @@
+#ifndef SOCKETHANDOFF_H
+#define SOCKETHANDOFF_H
+
+#include <string>
+
+// Передача слушающего сокета новому процессу при обновлении без простоя.
+// Старый сервер слушает управляющий Unix-сокет; новый подключается к нему,
+// получает дескриптор через SCM_RIGHTS и начинает accept на том же сокете,
+// пока старый дорабатывает свои сессии. Очередь подключений ядра общая,
+// поэтому ни одно подключение не отклоняется.
+//
+// Обмен: новый -> "TAKEOVER", старый -> fd (SCM_RIGHTS), новый -> "READY",
+// старый удаляет путь управляющего сокета и закрывает соединение (EOF),
+// после чего новый может занять этот путь для следующего обновления.
+class SocketHandoff {
+public:
+    // Управляющий сокет старого процесса
+    static int listenControl(const std::string& path);
+
+    // Сторона нового процесса: возвращает слушающий сокет или -1
+    static int takeover(const std::string& path);
+
+    // Сторона старого процесса: обслуживает одно подключение к управляющему сокету.
+    // true - сокет передан и путь удален, прием подключений нужно прекратить
+    static bool serveTakeover(int controlSocket, int listenSocket, const std::string& path);
+
+    static bool sendFd(int channel, int fd);
+    static int receiveFd(int channel);
+
+private:
+    static const int HANDOFF_TIMEOUT_SEC = 5;
+};
+
+#endif // SOCKETHANDOFF_H
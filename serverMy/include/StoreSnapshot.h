@@ -0,0 +1,85 @@
+#ifndef STORESNAPSHOT_H
+#define STORESNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <sys/types.h>
+#include "VectorStore.h"
+
+// Снимок хранилища именованных векторов в файле, пригодном для mmap:
+//   страница 0      - заголовок (FileHeader)
+//   со страницы 1   - индекс: записи векторов и их блоков с агрегатами
+//   далее           - данные блоков, каждый с границы страницы
+// При запуске файл отображается целиком, разбирается только индекс:
+// агрегаты доступны сразу, а страницы данных читаются с диска лишь
+// при первой записи в блок. Время старта не зависит от объема данных.
+//
+// Файл пишется во временный и переименовывается - снимок либо старый
+// целиком, либо новый целиком.
+class StoreSnapshot {
+public:
+    // Фоновый снимок: fork под блокировками хранилища, дочерний процесс
+    // пишет файл из своей копии памяти (copy-on-write) и завершается.
+    // Возвращает pid дочернего процесса или -1
+    static pid_t spawnWriter(VectorStore& store, const std::string& path);
+
+    // Снимок в текущем процессе (при остановке, когда сессий уже нет)
+    static bool write(VectorStore& store, const std::string& path);
+
+    // Загрузка при старте; vectors - число загруженных векторов
+    static bool load(VectorStore& store, const std::string& path, size_t& vectors, std::string& error);
+
+private:
+    static const uint32_t VERSION = 1;
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t pageSize;
+        uint32_t chunkElements;
+        uint32_t reserved;
+        uint64_t vectorCount;
+        uint64_t indexOffset;
+        uint64_t indexBytes;
+        uint64_t indexHash;     // XXH64 индекса: битый файл не загружается
+        uint64_t fileBytes;
+    };
+
+    struct VectorRecord {
+        uint16_t loginLength;
+        uint16_t nameLength;
+        uint32_t chunkCount;
+        uint64_t count;
+        double sum;
+        double compensation;
+        double min;
+        double max;
+        // далее логин, имя (с выравниванием до 8) и chunkCount записей ChunkRecord
+    };
+
+    struct ChunkRecord {
+        uint64_t offset;        // смещение данных блока в файле, кратно странице
+        uint32_t count;
+        uint32_t reserved;
+        double sum;
+        double compensation;
+        double min;
+        double max;
+    };
+
+    typedef std::vector<std::pair<std::string, std::shared_ptr<VectorStore::NamedVector>>> Entries;
+
+    // Все векторы под своими мьютексами, затем storeMutex:
+    // между lock и unlock хранилище неизменно
+    static Entries lockStore(VectorStore& store);
+    static void unlockStore(VectorStore& store, Entries& entries);
+
+    // Временный файл снимка (path + ".tmp"), -1 - ошибка
+    static int openTemp(const std::string& path);
+    // Пишет снимок в fd временного файла, закрывает его и переименовывает в path
+    static bool writeFile(const Entries& entries, int fd, const std::string& path);
+};
+
+#endif // STORESNAPSHOT_H
@@ -0,0 +1,141 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+// Корутина с результатом T. Запускается лениво - при co_await,
+// по завершении сразу продолжает ожидающую корутину (symmetric transfer),
+// поэтому цепочка вызовов не растит стек.
+// Исключение внутри корутины пробрасывается в точку co_await.
+// Результат co_await сохраняем в переменную, а не проверяем прямо в условии
+// if: GCC 12 не запускает задачу-временный объект из условия.
+template <typename T>
+class Task;
+
+namespace TaskDetail {
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    struct PromiseBase {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+}
+
+template <typename T>
+class Task {
+public:
+    struct promise_type : TaskDetail::PromiseBase {
+        std::optional<T> value;
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        void return_value(T result) { value = std::move(result); }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() {
+        if (handle.promise().exception) {
+            std::rethrow_exception(handle.promise().exception);
+        }
+        return std::move(*handle.promise().value);
+    }
+
+    // Выполнить вне исполнителя: ожидания сокетов становятся блокирующими
+    // (см. AsyncSocket), и корутина завершается до возврата
+    T runBlocking() {
+        handle.resume();
+        if (!handle.done()) {
+            throw std::logic_error("корутина приостановлена вне исполнителя");
+        }
+        return await_resume();
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <>
+class Task<void> {
+public:
+    struct promise_type : TaskDetail::PromiseBase {
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        void return_void() {}
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    void await_resume() {
+        if (handle.promise().exception) {
+            std::rethrow_exception(handle.promise().exception);
+        }
+    }
+
+    void runBlocking() {
+        handle.resume();
+        if (!handle.done()) {
+            throw std::logic_error("корутина приостановлена вне исполнителя");
+        }
+        await_resume();
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+#endif // TASK_H
@@ -0,0 +1,40 @@
+#ifndef TLSCONTEXT_H
+#define TLSCONTEXT_H
+
+#include <string>
+#include <openssl/types.h>
+
+// Контекст TLS для шифрованного порта (OpenSSL).
+// Включен ядерный TLS (SSL_OP_ENABLE_KTLS): если его поддерживают ядро
+// (модуль tls) и сборка OpenSSL, после рукопожатия ключи передаются ядру
+// и сессия работает с сокетом обычными recv/sendmsg. Иначе шифрует
+// сам процесс через SSL_read/SSL_write - протокол от этого не меняется.
+// OpenSSL 3.0 умеет ядерный прием только для TLS 1.2, отправку - и для 1.3.
+class TlsContext {
+public:
+    TlsContext();
+    ~TlsContext();
+
+    // Серверный контекст с сертификатом и ключом из PEM-файлов
+    bool loadCertificate(const std::string& certFile, const std::string& keyFile);
+    // Серверный контекст с самоподписанным сертификатом в памяти (бенчмарк)
+    bool generateSelfSigned();
+    // Клиентский контекст без проверки сертификата - только для бенчмарка
+    bool initializeClient();
+
+    // Новый объект соединения; nullptr - ошибка
+    SSL* newSession() const;
+    const std::string& getError() const { return error; }
+
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+
+private:
+    SSL_CTX* context;
+    std::string error;
+
+    bool createContext(bool server);
+    void setError(const std::string& what);
+};
+
+#endif // TLSCONTEXT_H
@@ -4,20 +4,90 @@
 #include <vector>
 #include <cstdint>
 #include <cstddef>  // Добавьте эту строку для size_t
+#include "ExactSum.h"
+
+// Тип элементов вектора, согласуемый в расширенном запросе
+enum class ElementType : uint8_t {
+    FLOAT32 = 1,
+    FLOAT64 = 2,
+    INT32 = 3,
+    INT64 = 4
+};
+
+// Статус результата по одному вектору в расширенном протоколе
+enum class ResultStatus : uint8_t {
+    OK = 0,
+    OVERFLOW = 1,
+    TRUNCATED = 2,  // данных меньше, чем объявлено в заголовке
+    OVERSIZE = 3,   // вектор больше Config::MAX_VECTOR_BYTES
+    MALFORMED = 4,  // некорректный блок или лишние данные после пакета
+    BUSY = 5,       // сервер перегружен: нет бюджета памяти под вектор
+    NOT_FOUND = 6,  // именованного вектора нет
+    EXISTS = 7,     // именованный вектор уже создан
+    QUOTA = 8,      // превышена квота памяти логина в хранилище
+    OUT_OF_RANGE = 9  // диапазон обновления выходит за длину вектора
+};
+
+// Порядок байтов, в котором клиент передает размеры и элементы
+enum class ByteOrder : uint8_t {
+    LITTLE = 0,
+    BIG = 1
+};
+
+// Точная сумма int64 без переполнения на любом числе элементов uint32
+__extension__ typedef __int128 int128_t;
 
 class VectorProcessor {
 public:
-    struct VectorResult {
-        uint32_t count;
-        std::vector<double> sums;
+    // Сумма типизированного вектора: для float32/float64 - double,
+    // для целых - int64 (с проверкой переполнения или насыщением)
+    struct TypedSum {
+        ResultStatus status;
+        union {
+            double real;
+            int64_t integer;
+        };
+    };
+    
+    // Состояние суммирования: вектор можно подавать частями (блоками)
+    struct SumState {
+        ElementType type;
+        bool exact;             // float32/float64: точная сумма вместо приближенной
+        double lanes[4];        // float32: независимые аккумуляторы
+        double sum;             // float64: сумма Кэхэна
+        double compensation;
+        int128_t integer;       // int32/int64: точная сумма
+        ExactSum exactSum;      // только при exact
     };
     
-    static VectorResult processVectors(const std::vector<uint8_t>& binaryData);
     static double calculateVectorSum(const std::vector<double>& vector);
+    static double calculateVectorSum(const double* data, size_t count);
+    
+    // Объявленный размер против Config::MAX_VECTOR_BYTES - до выделения памяти
+    static ResultStatus checkVectorSize(uint32_t count, ElementType type);
+    
+    // Перестановка байтов на месте (SSSE3 pshufb, если доступен)
+    static bool needsSwap(ByteOrder order);
+    static void toHostOrder(uint8_t* data, size_t count, size_t elemSize, ByteOrder order);
+    static uint32_t toHostOrder32(uint32_t value, ByteOrder order);
+    
+    static bool isValidElementType(uint8_t type);
+    static bool isIntegerType(ElementType type);
+    static size_t elementSize(ElementType type);
+    
+    // Суммирование count элементов; data выровнены по размеру элемента
+    // и уже в порядке байтов хоста. exact (FLAG_EXACT): float32/float64
+    // суммируются точно и округляются один раз - результат не зависит
+    // от порядка элементов и разбиения на блоки; на целые не влияет
+    static TypedSum sumTyped(ElementType type, const uint8_t* data, size_t count, bool saturate,
+                             bool exact = false);
+    
+    static void beginSum(SumState& state, ElementType type, bool exact = false);
+    static void accumulate(SumState& state, const uint8_t* data, size_t count);
+    static TypedSum finishSum(const SumState& state, bool saturate);
     
-private:
-    static bool readUInt32(const uint8_t* data, size_t& offset, size_t maxSize, uint32_t& value);
-    static bool readDouble(const uint8_t* data, size_t& offset, size_t maxSize, double& value);
+    template <typename T>
+    static void accumulateElements(SumState& state, const T* data, size_t count);
 };
 
 #endif // VECTORPROCESSOR_H
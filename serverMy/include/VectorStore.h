@@ -0,0 +1,104 @@
+#ifndef VECTORSTORE_H
+#define VECTORSTORE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include "VectorProcessor.h"
+#include "Config.h"
+
+// Именованные векторы, хранящиеся на сервере между запросами.
+// Клиент создает вектор, дописывает элементы или переписывает диапазон,
+// а сумма, число элементов, минимум и максимум поддерживаются на ходу:
+// запрос агрегатов - O(1) вместо повторной передачи всего вектора.
+// Имена принадлежат логину; память считается по квоте логина.
+class VectorStore {
+public:
+    struct Aggregates {
+        double sum;
+        uint64_t count;
+        double min;
+        double max;
+    };
+
+    // Блок элементов с агрегатами, выровненный по строке кэша:
+    // обновление диапазона пересчитывает только затронутые блоки
+    struct alignas(Config::CACHE_LINE_SIZE) Chunk {
+        double values[Config::STORE_CHUNK_ELEMENTS];
+        double sum;             // компенсированная сумма блока (Ноймайер)
+        double compensation;
+        double min;
+        double max;
+        uint32_t count;
+    };
+
+    // Блок только для чтения: в памяти или в отображенном файле снимка
+    struct ChunkView {
+        const double* values;
+        double sum;
+        double compensation;
+        double min;
+        double max;
+        uint32_t count;
+    };
+
+    explicit VectorStore(size_t quotaBytes);
+
+    static bool isStoreOp(uint8_t op);
+    static bool isValidName(const std::string& name);
+
+    ResultStatus create(const std::string& login, const std::string& name);
+    ResultStatus drop(const std::string& login, const std::string& name);
+    ResultStatus append(const std::string& login, const std::string& name,
+                        const double* values, size_t count, Aggregates& result);
+    ResultStatus update(const std::string& login, const std::string& name, uint64_t offset,
+                        const double* values, size_t count, Aggregates& result);
+    ResultStatus query(const std::string& login, const std::string& name, Aggregates& result);
+
+    size_t usage(const std::string& login) const;
+    size_t getQuota() const { return quotaBytes; }
+
+private:
+    friend class StoreSnapshot;
+
+    struct NamedVector {
+        std::mutex mutex;
+        // nullptr - блок еще в снимке (mapped), копируется при первой записи
+        std::vector<std::unique_ptr<Chunk>> chunks;
+        std::vector<ChunkView> mapped;
+        std::shared_ptr<const void> mapping;  // держит отображение файла снимка
+        uint64_t count;
+        double sum;             // итог по всем блокам
+        double compensation;
+        double min;
+        double max;
+        bool dropped;           // удален, пока сессия держала ссылку
+
+        NamedVector();
+    };
+
+    // Порядок блокировок: NamedVector::mutex, затем storeMutex
+    mutable std::mutex storeMutex;
+    std::unordered_map<std::string, std::shared_ptr<NamedVector>> vectors;
+    std::unordered_map<std::string, size_t> loginUsage;
+    size_t quotaBytes;
+
+    static std::string keyOf(const std::string& login, const std::string& name);
+    std::shared_ptr<NamedVector> find(const std::string& login, const std::string& name);
+
+    bool charge(const std::string& login, size_t bytes);
+    void refund(const std::string& login, size_t bytes);
+
+    static ChunkView viewOf(const NamedVector& vector, size_t index);
+    static Chunk& writableChunk(NamedVector& vector, size_t index);
+    static void resetChunk(Chunk& chunk);
+    static void recomputeChunk(Chunk& chunk);
+    static void recomputeTotals(NamedVector& vector);
+    static void fillAggregates(const NamedVector& vector, Aggregates& result);
+};
+
+#endif // VECTORSTORE_H
@@ -0,0 +1,125 @@
+#include "AdmissionController.h"
+#include "Executor.h"
+#include "Config.h"
+#include <chrono>
+
+AdmissionController::AdmissionController(const Limits& limits)
+    : limits(limits), connections(0), inflightBytes(0) {}
+
+bool AdmissionController::acquireConnection(int timeoutMs) {
+    std::unique_lock<std::mutex> lock(admissionMutex);
+
+    if (connections >= limits.maxConnections) {
+        if (timeoutMs <= 0 ||
+            !slotFreed.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                [this] { return connections < limits.maxConnections; })) {
+            return false;
+        }
+    }
+
+    connections++;
+    return true;
+}
+
+void AdmissionController::releaseConnection() {
+    {
+        std::lock_guard<std::mutex> lock(admissionMutex);
+        if (connections > 0) {
+            connections--;
+        }
+    }
+    slotFreed.notify_one();
+}
+
+bool AdmissionController::acquireLogin(const std::string& login) {
+    std::lock_guard<std::mutex> lock(admissionMutex);
+
+    size_t& sessions = loginSessions[login];
+    if (sessions >= limits.maxSessionsPerLogin) {
+        return false;
+    }
+
+    sessions++;
+    return true;
+}
+
+void AdmissionController::releaseLogin(const std::string& login) {
+    std::lock_guard<std::mutex> lock(admissionMutex);
+
+    auto it = loginSessions.find(login);
+    if (it == loginSessions.end()) {
+        return;
+    }
+
+    if (--it->second == 0) {
+        loginSessions.erase(it);
+    }
+}
+
+bool AdmissionController::acquireBytes(size_t bytes, int timeoutMs) {
+    if (bytes > limits.maxInflightBytes) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(admissionMutex);
+
+    // Пока ждем, сокет клиента не читается - TCP сам притормозит отправителя
+    auto fits = [this, bytes] { return inflightBytes + bytes <= limits.maxInflightBytes; };
+    if (!fits() &&
+        (timeoutMs <= 0 || !bytesFreed.wait_for(lock, std::chrono::milliseconds(timeoutMs), fits))) {
+        return false;
+    }
+
+    inflightBytes += bytes;
+    return true;
+}
+
+void AdmissionController::releaseBytes(size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(admissionMutex);
+        inflightBytes = bytes > inflightBytes ? 0 : inflightBytes - bytes;
+    }
+    bytesFreed.notify_all();
+}
+
+size_t AdmissionController::activeConnections() const {
+    std::lock_guard<std::mutex> lock(admissionMutex);
+    return connections;
+}
+
+size_t AdmissionController::inflight() const {
+    std::lock_guard<std::mutex> lock(admissionMutex);
+    return inflightBytes;
+}
+
+Task<bool> AdmissionController::BytesReservation::acquire(AdmissionController* controller, size_t amount,
+                                                          int timeoutMs) {
+    release();
+
+    // Без контроллера ограничений нет
+    if (controller == nullptr || amount == 0) {
+        co_return true;
+    }
+
+    // Повторные попытки с паузой вместо condition_variable: ожидание
+    // блокировало бы все сессии потока, включая ту, что держит бюджет
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!controller->acquireBytes(amount, 0)) {
+        if (amount > controller->limits.maxInflightBytes || std::chrono::steady_clock::now() >= deadline) {
+            co_return false;
+        }
+        co_await Executor::sleep(Config::ADMISSION_RETRY_MS);
+    }
+
+    owner = controller;
+    bytes = amount;
+    co_return true;
+}
+
+void AdmissionController::BytesReservation::release() {
+    if (owner != nullptr) {
+        owner->releaseBytes(bytes);
+        owner = nullptr;
+        bytes = 0;
+    }
+}
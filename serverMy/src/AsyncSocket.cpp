@@ -0,0 +1,309 @@
+#include "AsyncSocket.h"
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstring>
+#include <cerrno>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+AsyncSocket::AsyncSocket(int fd) 
+    : fd(fd), worker(Executor::current()), registered(false), tls(nullptr),
+      kernelRecv(false), kernelSend(false), writeWants(EPOLLOUT) {}
+
+AsyncSocket::~AsyncSocket() {
+    if (tls != nullptr) {
+        // close_notify без ожидания ответа: сокет закрывается следом
+        SSL_shutdown(tls);
+        SSL_free(tls);
+        ERR_clear_error();
+    }
+    if (registered && worker != nullptr) {
+        worker->forget(fd);
+    }
+}
+
+namespace {
+    // Ошибка SSL_* -> errno для вызывающего кода; EAGAIN - ждать событий wants
+    int tlsErrno(SSL* tls, int result, uint32_t& wants) {
+        int error = SSL_get_error(tls, result);
+        ERR_clear_error();
+        switch (error) {
+            case SSL_ERROR_WANT_READ:
+                wants = EPOLLIN;
+                return EAGAIN;
+            case SSL_ERROR_WANT_WRITE:
+                wants = EPOLLOUT;
+                return EAGAIN;
+            case SSL_ERROR_SYSCALL:
+                return errno != 0 ? errno : ECONNRESET;
+            default:
+                return EIO;
+        }
+    }
+}
+
+ssize_t AsyncSocket::readSome(void* buffer, size_t length, uint32_t& wants) {
+    wants = EPOLLIN;
+    if (tls == nullptr || kernelRecv) {
+        // При kTLS ядро отдает уже расшифрованные данные; служебная запись
+        // TLS (alert) дает EIO и завершает сессию
+        return recv(fd, buffer, length, MSG_DONTWAIT);
+    }
+
+    size_t received = 0;
+    int result = SSL_read_ex(tls, buffer, length, &received);
+    if (result == 1) {
+        return static_cast<ssize_t>(received);
+    }
+    if (SSL_get_error(tls, result) == SSL_ERROR_ZERO_RETURN) {
+        ERR_clear_error();
+        return 0;
+    }
+    errno = tlsErrno(tls, result, wants);
+    return -1;
+}
+
+ssize_t AsyncSocket::writeSome(const struct iovec* iov, int count) {
+    writeWants = EPOLLOUT;
+    if (tls == nullptr || kernelSend) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = const_cast<struct iovec*>(iov);
+        msg.msg_iovlen = count;
+        return sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+
+    // SSL_write не принимает iovec: одна запись TLS на сегмент,
+    // остальные сегменты уйдут следующими вызовами
+    size_t written = 0;
+    if (count == 0) {
+        return 0;
+    }
+    int result = SSL_write_ex(tls, iov[0].iov_base, iov[0].iov_len, &written);
+    if (result == 1) {
+        return static_cast<ssize_t>(written);
+    }
+    errno = tlsErrno(tls, result, writeWants);
+    return -1;
+}
+
+bool AsyncSocket::hasBufferedInput() const {
+    return tls != nullptr && !kernelRecv && SSL_pending(tls) > 0;
+}
+
+Task<bool> AsyncSocket::startTls(SSL* session, int timeoutMs) {
+    tls = session;
+    // Флага MSG_DONTWAIT у SSL_read нет: без O_NONBLOCK чтение из OpenSSL
+    // заблокировало бы поток исполнителя
+    int fileFlags = fcntl(fd, F_GETFL);
+    if (fileFlags < 0 || fcntl(fd, F_SETFL, fileFlags | O_NONBLOCK) < 0) {
+        co_return false;
+    }
+    if (tls == nullptr || SSL_set_fd(tls, fd) != 1) {
+        ERR_clear_error();
+        co_return false;
+    }
+    SSL_set_accept_state(tls);
+
+    while (true) {
+        int result = SSL_do_handshake(tls);
+        if (result == 1) {
+            break;
+        }
+        uint32_t wants = EPOLLIN;
+        errno = tlsErrno(tls, result, wants);
+        if (errno != EAGAIN) {
+            co_return false;
+        }
+        bool ready = co_await wait(wants, timeoutMs);
+        if (!ready) {
+            co_return false;
+        }
+    }
+
+    // Ядро берет шифрование на себя, если OpenSSL смог передать ему ключи
+    kernelSend = BIO_get_ktls_send(SSL_get_wbio(tls)) > 0;
+    kernelRecv = BIO_get_ktls_recv(SSL_get_rbio(tls)) > 0;
+    co_return true;
+}
+
+AsyncSocket::WaitAwaiter AsyncSocket::wait(uint32_t events, int timeoutMs) {
+    Executor::Waiter waiter;
+    waiter.fd = fd;
+    waiter.events = 0;
+    waiter.timed = false;
+    return WaitAwaiter{*this, events, timeoutMs, waiter, false};
+}
+
+bool AsyncSocket::WaitAwaiter::await_ready() {
+    if (socket.worker != nullptr) {
+        return false;
+    }
+
+    // POLLIN/POLLOUT совпадают с EPOLLIN/EPOLLOUT
+    struct pollfd pfd = {socket.fd, static_cast<short>(events), 0};
+    int result;
+    do {
+        result = poll(&pfd, 1, timeoutMs);
+    } while (result < 0 && errno == EINTR);
+    // Ошибка poll - как событие: следующий recv/send вернет ее сам
+    ready = result != 0;
+    return true;
+}
+
+bool AsyncSocket::WaitAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    waiter.handle = handle;
+    waiter.fd = socket.fd;
+    if (!socket.worker->watch(waiter, events, socket.registered, timeoutMs)) {
+        // fd нельзя ждать через epoll - продолжаем, ошибку покажет сам вызов
+        ready = true;
+        return false;
+    }
+    return true;
+}
+
+Task<ssize_t> AsyncSocket::receiveSome(void* buffer, size_t length, int timeoutMs) {
+    while (true) {
+        uint32_t wants;
+        ssize_t received = readSome(buffer, length, wants);
+        if (received >= 0) {
+            co_return received;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            co_return -1;
+        }
+        bool ready = co_await wait(wants, timeoutMs);
+        if (!ready) {
+            co_return -1;
+        }
+    }
+}
+
+Task<bool> AsyncSocket::receive(void* buffer, size_t length, int timeoutMs) {
+    char* ptr = static_cast<char*>(buffer);
+    size_t done = 0;
+
+    while (done < length) {
+        // Сначала пробуем прочитать: данные часто уже лежат в буфере сокета
+        uint32_t wants;
+        ssize_t received = readSome(ptr + done, length - done, wants);
+        if (received > 0) {
+            done += static_cast<size_t>(received);
+            continue;
+        }
+        if (received == 0) {
+            co_return false;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            co_return false;
+        }
+        bool ready = co_await wait(wants, timeoutMs);
+        if (!ready) {
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+Task<bool> AsyncSocket::send(const void* buffer, size_t length) {
+    const char* ptr = static_cast<const char*>(buffer);
+    size_t done = 0;
+
+    while (done < length) {
+        struct iovec iov;
+        iov.iov_base = const_cast<char*>(ptr + done);
+        iov.iov_len = length - done;
+        ssize_t sent = writeSome(&iov, 1);
+        if (sent > 0) {
+            done += static_cast<size_t>(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            co_return false;
+        }
+        bool ready = co_await wait(writeWants, -1);
+        if (!ready) {
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+Task<bool> AsyncSocket::receiveWithFd(void* buffer, size_t length, int& receivedFd, int timeoutMs) {
+    receivedFd = -1;
+
+    struct iovec iov;
+    iov.iov_base = buffer;
+    iov.iov_len = length;
+
+    // Без union с cmsghdr: гибкий массив в нем не может лежать в кадре корутины
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+
+    // Дескриптор приходит вместе с первым байтом сообщения - его читаем через recvmsg
+    ssize_t received;
+    while (true) {
+        memset(control, 0, sizeof(control));
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        received = recvmsg(fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (received > 0) {
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            if (cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+                cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+                memcpy(&receivedFd, CMSG_DATA(cmsg), sizeof(int));
+            }
+            // Лишние дескрипторы ядро закрыло бы молча - такой запрос не принимаем
+            if (msg.msg_flags & MSG_CTRUNC) {
+                if (receivedFd >= 0) {
+                    close(receivedFd);
+                    receivedFd = -1;
+                }
+                co_return false;
+            }
+            break;
+        }
+        if (received == 0) {
+            co_return false;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            co_return false;
+        }
+        bool ready = co_await wait(EPOLLIN, timeoutMs);
+        if (!ready) {
+            co_return false;
+        }
+    }
+
+    size_t done = static_cast<size_t>(received);
+    if (done < length) {
+        bool rest = co_await receive(static_cast<char*>(buffer) + done, length - done, timeoutMs);
+        if (!rest) {
+            if (receivedFd >= 0) {
+                close(receivedFd);
+                receivedFd = -1;
+            }
+            co_return false;
+        }
+    }
+    co_return true;
+}
@@ -0,0 +1,1055 @@
+#include "Benchmark.h"
+#include "Protocol.h"
+#include "AsyncSocket.h"
+#include "OutputQueue.h"
+#include "Session.h"
+#include "SharedRegion.h"
+#include "VectorProcessor.h"
+#include "Compression.h"
+#include "NumaPlacement.h"
+#include "ResultCache.h"
+#include "TlsContext.h"
+#include "Executor.h"
+#include "FairScheduler.h"
+#include "FlightRecorder.h"
+#include "ExactSum.h"
+#include "Config.h"
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <openssl/ssl.h>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+
+namespace {
+    const size_t BENCH_ELEMENTS = 4 * 1024 * 1024;  // 32 МБ double
+    const size_t NUMA_BENCH_ELEMENTS = 32 * 1024 * 1024;  // 256 МБ: больше любого LLC
+    const int NUMA_BENCH_REPEATS = 3;
+    const size_t CACHE_BENCH_BYTES = 256 * 1024 * 1024;  // объем на каждое измерение
+    const size_t TRANSPORT_VECTOR_ELEMENTS = 128 * 1024;  // 1 МБ double
+    const uint32_t TRANSPORT_VECTORS = 1024;              // 1 ГБ на каждый транспорт
+    const uint32_t TRANSPORT_RING_SLOTS = 16;             // векторов в кольце общей памяти
+    const int QOS_BULK_SESSIONS = 2;                      // потоковые клиенты по 1 МБ на вектор
+    const uint32_t QOS_PROBES = 2000;                     // короткие запросы интерактивного клиента
+    const size_t QOS_PROBE_ELEMENTS = 16;
+    const uint32_t QOS_BULK_VECTORS = 1u << 30;           // до закрытия соединения клиентом
+    const uint64_t TRACE_BENCH_STAGES = 20000000;         // этапов на каждое измерение
+    const int TRACE_BENCH_SNAPSHOTS = 200;                // чтений колец во время записи
+    const int EXACT_BENCH_PARTITIONS = 7;                 // случайных частей при проверке merge
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double gbPerSecond(size_t bytes, double seconds) {
+        return seconds > 0 ? bytes / seconds / 1e9 : 0.0;
+    }
+
+    // Наносекунды на вызов: повторяем, пока не обработаем CACHE_BENCH_BYTES
+    template<typename Func>
+    double nanosPerCall(size_t bytesPerCall, Func func) {
+        size_t calls = std::max<size_t>(CACHE_BENCH_BYTES / bytesPerCall, 16);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < calls; i++) {
+            func();
+        }
+        return secondsSince(start) * 1e9 / calls;
+    }
+
+    // Гладкий ряд как с датчика: два знака после запятой, медленный дрейф
+    std::vector<double> smoothSeries(size_t count) {
+        std::vector<double> data(count);
+        std::mt19937_64 gen(42);
+        std::normal_distribution<double> noise(0.0, 0.02);
+        for (size_t i = 0; i < count; i++) {
+            double value = 20.0 + 5.0 * std::sin(i / 5000.0) + noise(gen);
+            data[i] = std::round(value * 100.0) / 100.0;
+        }
+        return data;
+    }
+
+    std::vector<double> randomSeries(size_t count) {
+        std::vector<double> data(count);
+        std::mt19937_64 gen(7);
+        std::uniform_real_distribution<double> dist(-1e6, 1e6);
+        for (double& value : data) {
+            value = dist(gen);
+        }
+        return data;
+    }
+
+    // Сильная взаимная компенсация: пары x, -x с порядками до 2^300 и малые
+    // целые между ними. Точная сумма - сумма целых, приближенные ее теряют
+    std::vector<double> cancellingSeries(size_t count, double& exactSum) {
+        std::vector<double> data;
+        data.reserve(count);
+        std::mt19937_64 gen(11);
+        std::uniform_real_distribution<double> mantissa(-1.0, 1.0);
+        std::uniform_int_distribution<int> exponent(0, 300);
+        std::uniform_int_distribution<int> small(-1000, 1000);
+        exactSum = 0;
+        while (data.size() + 4 <= count) {
+            double big = std::ldexp(mantissa(gen), exponent(gen));
+            double first = small(gen);
+            double second = small(gen);
+            data.insert(data.end(), {big, first, -big, second});
+            exactSum += first + second;
+        }
+        while (data.size() < count) {
+            data.push_back(0.0);
+        }
+        std::shuffle(data.begin(), data.end(), gen);
+        return data;
+    }
+
+    // Простое суммирование с восемью независимыми аккумуляторами - векторизуется
+    double simdSum(const double* data, size_t count) {
+        double acc[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            for (int lane = 0; lane < 8; lane++) {
+                acc[lane] += data[i + lane];
+            }
+        }
+        for (; i < count; i++) {
+            acc[0] += data[i];
+        }
+        return ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+    }
+
+    bool sameBits(double a, double b) {
+        return std::memcmp(&a, &b, sizeof(double)) == 0;
+    }
+
+    // Клиентская сторона: кодирует вектор блоками и отправляет в сокет
+    void sendCompressed(int fd, const std::vector<double>& data, uint8_t mode, size_t& wireBytes) {
+        const uint8_t* raw = reinterpret_cast<const uint8_t*>(data.data());
+        size_t total = data.size() * sizeof(double);
+        uint64_t prev = 0;
+        std::vector<uint8_t> encoded;
+        wireBytes = 0;
+
+        for (size_t offset = 0; offset < total; offset += Config::COMPRESSION_BLOCK_SIZE) {
+            size_t rawBytes = std::min(total - offset, static_cast<size_t>(Config::COMPRESSION_BLOCK_SIZE));
+            Compression::encodeBlock(raw + offset, rawBytes, sizeof(double), mode, prev, encoded);
+
+            uint32_t header[2] = {static_cast<uint32_t>(rawBytes), static_cast<uint32_t>(encoded.size())};
+            if (!Protocol::sendAll(fd, header, sizeof(header)) ||
+                !Protocol::sendAll(fd, encoded.data(), encoded.size())) {
+                return;
+            }
+            wireBytes += sizeof(header) + encoded.size();
+        }
+    }
+
+    // Ответы [u8 статус][8 байт суммы] на count векторов: все OK и с ожидаемой суммой
+    bool readReplies(int fd, uint32_t count, double expected) {
+        uint8_t reply[1 + sizeof(double)];
+        bool ok = true;
+        for (uint32_t i = 0; i < count; i++) {
+            if (!Protocol::recvAll(fd, reply, sizeof(reply))) {
+                return false;
+            }
+            double sum;
+            memcpy(&sum, reply + 1, sizeof(sum));
+            ok = ok && reply[0] == static_cast<uint8_t>(ResultStatus::OK) && sum == expected;
+        }
+        return ok;
+    }
+
+    // Клиент TCP и Unix-сокета: векторы целиком через сокет
+    void streamClient(int fd, const std::vector<double>& vector, double expected, bool& ok) {
+        uint32_t size = static_cast<uint32_t>(vector.size());
+        ok = true;
+        for (uint32_t i = 0; i < TRANSPORT_VECTORS && ok; i++) {
+            ok = Protocol::sendAll(fd, &size, sizeof(size)) &&
+                 Protocol::sendAll(fd, vector.data(), vector.size() * sizeof(double));
+        }
+        char answer[2];
+        ok = ok && Protocol::recvAll(fd, answer, sizeof(answer)) &&
+             readReplies(fd, TRANSPORT_VECTORS, expected);
+    }
+
+    bool sendWithFd(int fd, const void* data, size_t length, int passFd) {
+        struct iovec iov;
+        iov.iov_base = const_cast<void*>(data);
+        iov.iov_len = length;
+
+        union {
+            char buffer[CMSG_SPACE(sizeof(int))];
+            struct cmsghdr align;
+        } control;
+        memset(&control, 0, sizeof(control));
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = sizeof(control.buffer);
+
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &passFd, sizeof(int));
+
+        return sendmsg(fd, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(length);
+    }
+
+    // Клиент общей памяти: вектор пишется в слот кольца, по сокету - только
+    // дескриптор; слот переиспользуется после ответа на вектор в нем
+    void sharedClient(int fd, const std::vector<double>& vector, double expected, bool& ok) {
+        size_t vectorBytes = vector.size() * sizeof(double);
+        uint64_t regionSize = static_cast<uint64_t>(vectorBytes) * TRANSPORT_RING_SLOTS;
+        ok = false;
+
+        int regionFd = SharedRegion::create(regionSize);
+        if (regionFd < 0) {
+            return;
+        }
+        void* base = mmap(nullptr, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, regionFd, 0);
+        char answer[2];
+        if (base == MAP_FAILED ||
+            !Protocol::recvAll(fd, answer, sizeof(answer)) ||
+            !sendWithFd(fd, &regionSize, sizeof(regionSize), regionFd) ||
+            !Protocol::recvAll(fd, answer, sizeof(answer)) || memcmp(answer, "OK", 2) != 0) {
+            if (base != MAP_FAILED) {
+                munmap(base, regionSize);
+            }
+            close(regionFd);
+            return;
+        }
+        close(regionFd);
+
+        uint8_t* ring = static_cast<uint8_t*>(base);
+        bool replies = true;
+        for (uint32_t i = 0; i < TRANSPORT_VECTORS; i++) {
+            if (i >= TRANSPORT_RING_SLOTS) {
+                replies = replies && readReplies(fd, 1, expected);
+            }
+            uint64_t offset = static_cast<uint64_t>(i % TRANSPORT_RING_SLOTS) * vectorBytes;
+            memcpy(ring + offset, vector.data(), vectorBytes);
+
+            uint8_t descriptor[sizeof(uint64_t) + sizeof(uint32_t)];
+            uint32_t count = static_cast<uint32_t>(vector.size());
+            memcpy(descriptor, &offset, sizeof(offset));
+            memcpy(descriptor + sizeof(offset), &count, sizeof(count));
+            if (!Protocol::sendAll(fd, descriptor, sizeof(descriptor))) {
+                munmap(base, regionSize);
+                return;
+            }
+        }
+        ok = replies && readReplies(fd, std::min(TRANSPORT_VECTORS, TRANSPORT_RING_SLOTS), expected);
+        munmap(base, regionSize);
+    }
+
+    // Контекст разрешает частичную запись: SSL_write может отправить не все
+    bool tlsWriteAll(SSL* tls, const void* data, size_t length) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        while (length > 0) {
+            size_t written = 0;
+            if (SSL_write_ex(tls, bytes, length, &written) != 1) {
+                return false;
+            }
+            bytes += written;
+            length -= written;
+        }
+        return true;
+    }
+
+    bool tlsReadAll(SSL* tls, void* data, size_t length) {
+        uint8_t* bytes = static_cast<uint8_t*>(data);
+        while (length > 0) {
+            size_t got = 0;
+            if (SSL_read_ex(tls, bytes, length, &got) != 1) {
+                return false;
+            }
+            bytes += got;
+            length -= got;
+        }
+        return true;
+    }
+
+    // Клиент TLS: тот же поток, что у streamClient, через блокирующий SSL
+    void tlsClient(int fd, const TlsContext& context, const std::vector<double>& vector,
+                   double expected, bool& ok) {
+        SSL* tls = context.newSession();
+        ok = tls != nullptr && SSL_set_fd(tls, fd) == 1 && SSL_connect(tls) == 1;
+
+        uint32_t size = static_cast<uint32_t>(vector.size());
+        for (uint32_t i = 0; i < TRANSPORT_VECTORS && ok; i++) {
+            ok = tlsWriteAll(tls, &size, sizeof(size)) &&
+                 tlsWriteAll(tls, vector.data(), vector.size() * sizeof(double));
+        }
+        char answer[2];
+        ok = ok && tlsReadAll(tls, answer, sizeof(answer));
+
+        uint8_t reply[1 + sizeof(double)];
+        for (uint32_t i = 0; i < TRANSPORT_VECTORS && ok; i++) {
+            double sum;
+            ok = tlsReadAll(tls, reply, sizeof(reply));
+            memcpy(&sum, reply + 1, sizeof(sum));
+            ok = ok && reply[0] == static_cast<uint8_t>(ResultStatus::OK) && sum == expected;
+        }
+        SSL_free(tls);
+    }
+
+    // Сессия в потоке исполнителя, как на сервере: с очередью логина или без нее
+    Task<void> qosSession(int fd, std::string login, QosProfile profile, bool scheduled,
+                          uint32_t vectors, std::atomic<int>& finished) {
+        {
+            AsyncSocket socket(fd);
+            OutputQueue out(socket);
+            Session session(socket, out);
+            session.login = login;
+            FairScheduler* scheduler = FairScheduler::current();
+            if (scheduled) {
+                session.flow = scheduler->attach(login, profile);
+            }
+
+            Protocol::RequestHeader header;
+            header.op = Config::OP_SUM;
+            header.elementType = static_cast<uint8_t>(ElementType::FLOAT64);
+            header.flags = 0;
+            header.compression = static_cast<uint8_t>(CompressionMode::NONE);
+            header.numVectors = vectors;
+
+            // Потоковая сессия заканчивается обрывом соединения - результат не важен
+            size_t bytesReceived = 0;
+            bool processed = co_await Protocol::receiveTypedVectors(session, header, bytesReceived);
+            (void)processed;
+            if (scheduled) {
+                scheduler->detach(session.flow);
+            }
+        }
+        finished++;
+    }
+
+    // Потоковый клиент: 1 МБ векторы без ожидания ответов, пока не велят остановиться
+    void bulkClient(int fd, const std::vector<double>& vector, const std::atomic<bool>& stop,
+                    std::atomic<size_t>& bytesSent) {
+        uint32_t size = static_cast<uint32_t>(vector.size());
+        char answer[2];
+        if (!Protocol::recvAll(fd, answer, sizeof(answer))) {
+            return;
+        }
+        while (!stop && Protocol::sendAll(fd, &size, sizeof(size)) &&
+               Protocol::sendAll(fd, vector.data(), vector.size() * sizeof(double))) {
+            bytesSent += sizeof(size) + vector.size() * sizeof(double);
+        }
+    }
+
+    // Интерактивный клиент: короткий вектор и ожидание ответа; задержки в мкс
+    void probeClient(int fd, std::vector<double>& latencies, bool& ok) {
+        std::vector<double> vector(QOS_PROBE_ELEMENTS, 1.0);
+        uint32_t size = static_cast<uint32_t>(vector.size());
+        char answer[2];
+        ok = Protocol::recvAll(fd, answer, sizeof(answer));
+        for (uint32_t i = 0; i < QOS_PROBES && ok; i++) {
+            auto start = std::chrono::steady_clock::now();
+            ok = Protocol::sendAll(fd, &size, sizeof(size)) &&
+                 Protocol::sendAll(fd, vector.data(), vector.size() * sizeof(double)) &&
+                 readReplies(fd, 1, static_cast<double>(QOS_PROBE_ELEMENTS));
+            latencies.push_back(secondsSince(start) * 1e6);
+        }
+    }
+}
+
+int Benchmark::run(const std::string& name) {
+    if (name == "compression") {
+        return compression();
+    }
+    if (name == "numa") {
+        return numa();
+    }
+    if (name == "cache") {
+        return cache();
+    }
+    if (name == "transport") {
+        return transport();
+    }
+    if (name == "tls") {
+        return tls();
+    }
+    if (name == "qos") {
+        return qos();
+    }
+    if (name == "trace") {
+        return trace();
+    }
+    if (name == "exact") {
+        return exact();
+    }
+
+    std::cerr << "Неизвестный бенчмарк: " << name << "\n";
+    printUsage();
+    return 1;
+}
+
+void Benchmark::printUsage() {
+    std::cout << "Бенчмарки (--bench NAME):\n";
+    std::cout << "  compression   Степень сжатия и сквозная скорость для гладких и случайных данных\n";
+    std::cout << "  numa          Скорость суммирования при локальной и удаленной памяти NUMA-узлов\n";
+    std::cout << "  cache         Стоимость хэша и поиска в кэше против суммы: точка окупаемости\n";
+    std::cout << "  transport     Скорость приема векторов: TCP loopback, Unix-сокет, общая память\n";
+    std::cout << "  tls           Скорость приема векторов: открытый TCP против TLS (ядерный или OpenSSL)\n";
+    std::cout << "  qos           Задержка коротких запросов рядом с потоковыми: без планировщика, DRR, классы\n";
+    std::cout << "  trace         Стоимость этапа в бортовом самописце, чтение колец во время записи, дамп\n";
+    std::cout << "  exact         Точная сумма против SIMD и Кэхэна: скорость, ошибка, воспроизводимость\n";
+}
+
+bool Benchmark::loopbackPair(int& clientFd, int& serverFd) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;  // любой свободный порт
+    socklen_t addrLen = sizeof(addr);
+
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(listener, 1) < 0 ||
+        getsockname(listener, (struct sockaddr*)&addr, &addrLen) < 0) {
+        close(listener);
+        return false;
+    }
+
+    clientFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (clientFd < 0 || connect(clientFd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(listener);
+        return false;
+    }
+
+    serverFd = accept(listener, nullptr, nullptr);
+    close(listener);
+    if (serverFd < 0) {
+        close(clientFd);
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    setsockopt(serverFd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    return true;
+}
+
+int Benchmark::compression() {
+    struct Dataset {
+        const char* name;
+        std::vector<double> data;
+    };
+    struct Mode {
+        const char* name;
+        uint8_t value;
+    };
+
+    Dataset datasets[] = {
+        {"smooth", smoothSeries(BENCH_ELEMENTS)},
+        {"random", randomSeries(BENCH_ELEMENTS)}
+    };
+    const Mode modes[] = {
+        {"none", static_cast<uint8_t>(CompressionMode::NONE)},
+        {"shuffle", static_cast<uint8_t>(CompressionMode::SHUFFLE)},
+        {"xor", static_cast<uint8_t>(CompressionMode::XOR_DELTA)},
+        {"shuffle+lz4", static_cast<uint8_t>(static_cast<uint8_t>(CompressionMode::SHUFFLE) | Compression::FLAG_LZ4)},
+        {"xor+lz4", static_cast<uint8_t>(static_cast<uint8_t>(CompressionMode::XOR_DELTA) | Compression::FLAG_LZ4)}
+    };
+
+    std::cout << "Сжатие векторов: " << BENCH_ELEMENTS << " x float64, блок "
+              << Config::COMPRESSION_BLOCK_SIZE << " байт\n";
+    std::cout << std::left << std::setw(8) << "data" << std::setw(13) << "mode"
+              << std::right << std::setw(8) << "ratio" << std::setw(14) << "encode GB/s"
+              << std::setw(16) << "end-to-end GB/s" << "  check\n";
+
+    for (const Dataset& dataset : datasets) {
+        size_t rawBytes = dataset.data.size() * sizeof(double);
+        VectorProcessor::TypedSum expected = VectorProcessor::sumTyped(
+            ElementType::FLOAT64, reinterpret_cast<const uint8_t*>(dataset.data.data()),
+            dataset.data.size(), false);
+
+        for (const Mode& mode : modes) {
+            // Стоимость кодирования на клиенте отдельно от передачи
+            auto encodeStart = std::chrono::steady_clock::now();
+            {
+                const uint8_t* raw = reinterpret_cast<const uint8_t*>(dataset.data.data());
+                std::vector<uint8_t> encoded;
+                uint64_t prev = 0;
+                for (size_t offset = 0; offset < rawBytes; offset += Config::COMPRESSION_BLOCK_SIZE) {
+                    size_t blockBytes = std::min(rawBytes - offset, static_cast<size_t>(Config::COMPRESSION_BLOCK_SIZE));
+                    Compression::encodeBlock(raw + offset, blockBytes, sizeof(double), mode.value, prev, encoded);
+                }
+            }
+            double encodeSeconds = secondsSince(encodeStart);
+
+            int clientFd = -1;
+            int serverFd = -1;
+            if (!loopbackPair(clientFd, serverFd)) {
+                std::cerr << "Не удалось создать loopback-соединение\n";
+                return 1;
+            }
+
+            // Сквозной путь: кодирование -> TCP loopback -> распаковка -> сумма
+            size_t wireBytes = 0;
+            auto start = std::chrono::steady_clock::now();
+            std::thread sender(sendCompressed, clientFd, std::cref(dataset.data), mode.value, std::ref(wireBytes));
+
+            VectorProcessor::SumState state;
+            VectorProcessor::beginSum(state, ElementType::FLOAT64);
+            Protocol::DecodeBuffers buffers;
+            ResultStatus status = ResultStatus::OK;
+            AsyncSocket serverSocket(serverFd);
+            bool received = Protocol::receiveCompressedVector(
+                serverSocket, static_cast<uint32_t>(dataset.data.size()), mode.value, ByteOrder::LITTLE,
+                state, buffers, status).runBlocking();
+            VectorProcessor::TypedSum sum = VectorProcessor::finishSum(state, false);
+
+            sender.join();
+            double seconds = secondsSince(start);
+            close(clientFd);
+            close(serverFd);
+
+            bool match = received && sum.real == expected.real;
+            std::cout << std::left << std::setw(8) << dataset.name << std::setw(13) << mode.name
+                      << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(8) << (wireBytes ? static_cast<double>(rawBytes) / wireBytes : 0.0)
+                      << std::setw(14) << gbPerSecond(rawBytes, encodeSeconds)
+                      << std::setw(16) << gbPerSecond(rawBytes, seconds)
+                      << "  " << (match ? "ok" : "MISMATCH") << "\n";
+        }
+    }
+
+    return 0;
+}
+
+int Benchmark::numa() {
+    int nodes = NumaPlacement::nodeCount();
+    size_t bytes = NUMA_BENCH_ELEMENTS * sizeof(double);
+
+    std::cout << "NUMA: узлов " << nodes << ", libnuma " 
+              << (NumaPlacement::libnumaAvailable() ? "да" : "нет (first-touch)")
+              << ", буфер " << bytes / (1024 * 1024) << " МБ\n";
+    std::cout << std::left << std::setw(10) << "cpu node" << std::setw(10) << "mem node"
+              << std::right << std::setw(12) << "read GB/s" << std::setw(14) << "kernel GB/s" << "\n";
+
+    for (int memNode = 0; memNode < nodes; memNode++) {
+        if (NumaPlacement::nodeCpus(memNode).empty()) {
+            continue;
+        }
+
+        double* data = static_cast<double*>(NumaPlacement::allocateOnNode(bytes, memNode));
+        if (data == nullptr) {
+            std::cerr << "Не удалось выделить память на узле " << memNode << "\n";
+            return 1;
+        }
+        for (size_t i = 0; i < NUMA_BENCH_ELEMENTS; i++) {
+            data[i] = static_cast<double>(i & 0xFF);
+        }
+
+        for (int cpuNode = 0; cpuNode < nodes; cpuNode++) {
+            if (NumaPlacement::nodeCpus(cpuNode).empty()) {
+                continue;
+            }
+
+            // Замер в отдельном потоке, привязанном к узлу: как поток сессии
+            double readSeconds = 0;
+            double kernelSeconds = 0;
+            double checksum = 0;
+            std::thread worker([&] {
+                NumaPlacement::bindThreadToNode(cpuNode, std::vector<int>());
+                for (int repeat = 0; repeat < NUMA_BENCH_REPEATS; repeat++) {
+                    // Чистое чтение: четыре независимых сумматора
+                    auto start = std::chrono::steady_clock::now();
+                    double lanes[4] = {0, 0, 0, 0};
+                    for (size_t i = 0; i < NUMA_BENCH_ELEMENTS; i += 4) {
+                        lanes[0] += data[i];
+                        lanes[1] += data[i + 1];
+                        lanes[2] += data[i + 2];
+                        lanes[3] += data[i + 3];
+                    }
+                    double seconds = secondsSince(start);
+                    checksum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+                    readSeconds = repeat == 0 ? seconds : std::min(readSeconds, seconds);
+
+                    // Серверное ядро суммирования float64
+                    start = std::chrono::steady_clock::now();
+                    VectorProcessor::TypedSum sum = VectorProcessor::sumTyped(
+                        ElementType::FLOAT64, reinterpret_cast<const uint8_t*>(data),
+                        NUMA_BENCH_ELEMENTS, false);
+                    seconds = secondsSince(start);
+                    checksum += sum.real;
+                    kernelSeconds = repeat == 0 ? seconds : std::min(kernelSeconds, seconds);
+                }
+            });
+            worker.join();
+
+            std::cout << std::left << std::setw(10) << cpuNode << std::setw(10) << memNode
+                      << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(12) << gbPerSecond(bytes, readSeconds)
+                      << std::setw(14) << gbPerSecond(bytes, kernelSeconds)
+                      << (cpuNode == memNode ? "  local" : "  remote")
+                      << (checksum == 0 ? " (empty)" : "") << "\n";
+        }
+
+        NumaPlacement::freeOnNode(data, bytes);
+    }
+
+    return 0;
+}
+
+int Benchmark::cache() {
+    const size_t sizes[] = {16, 64, 256, 512, 1024, 4096, 16384, 65536, 262144, 1048576};
+
+    std::cout << "Кэш результатов: хэш XXH64 + поиск против суммирования (нс на вектор)\n";
+    std::cout << std::right << std::setw(10) << "bytes" << std::setw(11) << "legacy" 
+              << std::setw(11) << "float32" << std::setw(11) << "float64" 
+              << std::setw(11) << "int32" << std::setw(11) << "int64"
+              << std::setw(11) << "hash+hit" << std::setw(11) << "hash GB/s"
+              << "  break-even hit rate (legacy / f32 / f64 / i32 / i64)\n";
+
+    ResultCache cache(1024);
+    volatile double sink = 0;
+
+    for (size_t count : sizes) {
+        std::vector<double> data = randomSeries(count);
+        const uint8_t* raw = reinterpret_cast<const uint8_t*>(data.data());
+        size_t bytes = count * sizeof(double);
+
+        double legacy = nanosPerCall(bytes, [&] {
+            double sum = 0;
+            for (double value : data) {
+                sum += value;
+            }
+            sink = sink + sum;
+        });
+        // Те же байты как векторы каждого типа: стоимость суммы на байт
+        double typed[4];
+        const ElementType types[] = {ElementType::FLOAT32, ElementType::FLOAT64, 
+                                     ElementType::INT32, ElementType::INT64};
+        for (int t = 0; t < 4; t++) {
+            size_t elements = bytes / VectorProcessor::elementSize(types[t]);
+            typed[t] = nanosPerCall(bytes, [&] {
+                sink = sink + VectorProcessor::sumTyped(types[t], raw, elements, true).integer;
+            });
+        }
+
+        // Попадание: хэш всего вектора и поиск под мьютексом шарда
+        uint32_t kind = ResultCache::kindOf(ElementType::FLOAT64, 0);
+        const std::string login = "bench";
+        cache.insert(cache.makeKey(kind, login, raw, bytes), VectorProcessor::TypedSum());
+        double hit = nanosPerCall(bytes, [&] {
+            VectorProcessor::TypedSum result;
+            sink = sink + cache.lookup(cache.makeKey(kind, login, raw, bytes), result);
+        });
+
+        // Промах стоит hash+hit сверх суммы, попадание экономит сумму:
+        // кэш окупается при доле попаданий выше hit / sum
+        auto breakEven = [hit](double sum) {
+            std::ostringstream text;
+            if (hit >= sum) {
+                text << "never";
+            } else {
+                text << std::fixed << std::setprecision(0) << 100.0 * hit / sum << "%";
+            }
+            return text.str();
+        };
+
+        std::cout << std::setw(10) << bytes << std::fixed << std::setprecision(1)
+                  << std::setw(11) << legacy;
+        for (double nanos : typed) {
+            std::cout << std::setw(11) << nanos;
+        }
+        std::cout << std::setw(11) << hit << std::setw(11) << std::setprecision(2) << bytes / hit
+                  << "  " << breakEven(legacy);
+        for (double nanos : typed) {
+            std::cout << " / " << breakEven(nanos);
+        }
+        std::cout << "\n";
+    }
+
+    std::cout << "Кэшируются только float64 от RESULT_CACHE_MIN_BYTES = " 
+              << Config::RESULT_CACHE_MIN_BYTES << " байт\n";
+    return 0;
+}
+
+bool Benchmark::serveSum(AsyncSocket& socket, uint8_t flags, bool local, uint32_t vectors) {
+    OutputQueue out(socket);
+    Session session(socket, out);
+    session.login = "bench";
+    session.local = local;
+
+    Protocol::RequestHeader header;
+    header.op = Config::OP_SUM;
+    header.elementType = static_cast<uint8_t>(ElementType::FLOAT64);
+    header.flags = flags;
+    header.compression = static_cast<uint8_t>(CompressionMode::NONE);
+    header.numVectors = vectors;
+
+    size_t bytesReceived = 0;
+    return Protocol::receiveTypedVectors(session, header, bytesReceived).runBlocking();
+}
+
+int Benchmark::transport() {
+    std::vector<double> vector = randomSeries(TRANSPORT_VECTOR_ELEMENTS);
+    double expected = VectorProcessor::sumTyped(ElementType::FLOAT64,
+                                                reinterpret_cast<const uint8_t*>(vector.data()),
+                                                vector.size(), false).real;
+    size_t totalBytes = vector.size() * sizeof(double) * TRANSPORT_VECTORS;
+
+    std::cout << "Транспорт: " << TRANSPORT_VECTORS << " векторов x " << TRANSPORT_VECTOR_ELEMENTS
+              << " float64, прием и сумма кодом сессии\n";
+    std::cout << std::left << std::setw(10) << "transport" << std::right << std::setw(10) << "GB/s"
+              << "  check\n";
+
+    const char* names[] = {"tcp", "unix", "shm"};
+    for (int mode = 0; mode < 3; mode++) {
+        int clientFd = -1;
+        int serverFd = -1;
+        if (mode == 0) {
+            if (!loopbackPair(clientFd, serverFd)) {
+                std::cerr << "Не удалось создать loopback-соединение\n";
+                return 1;
+            }
+        } else {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0) {
+                std::cerr << "Не удалось создать Unix-сокеты\n";
+                return 1;
+            }
+            clientFd = pair[0];
+            serverFd = pair[1];
+        }
+
+        bool clientOk = false;
+        auto start = std::chrono::steady_clock::now();
+        std::thread client(mode == 2 ? sharedClient : streamClient, clientFd, std::cref(vector),
+                           expected, std::ref(clientOk));
+        bool served = false;
+        {
+            AsyncSocket socket(serverFd);
+            served = serveSum(socket, mode == 2 ? Config::FLAG_SHARED_MEMORY : 0, mode != 0,
+                              TRANSPORT_VECTORS);
+        }
+        client.join();
+        double seconds = secondsSince(start);
+        close(clientFd);
+        close(serverFd);
+
+        std::cout << std::left << std::setw(10) << names[mode] << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(10) << gbPerSecond(totalBytes, seconds)
+                  << "  " << (served && clientOk ? "ok" : "FAIL") << "\n";
+    }
+
+    return 0;
+}
+
+int Benchmark::tls() {
+    TlsContext serverContext;
+    TlsContext clientContext;
+    if (!serverContext.generateSelfSigned() || !clientContext.initializeClient()) {
+        std::cerr << "Не удалось создать контекст TLS: " << serverContext.getError()
+                  << clientContext.getError() << "\n";
+        return 1;
+    }
+
+    std::vector<double> vector = randomSeries(TRANSPORT_VECTOR_ELEMENTS);
+    double expected = VectorProcessor::sumTyped(ElementType::FLOAT64,
+                                                reinterpret_cast<const uint8_t*>(vector.data()),
+                                                vector.size(), false).real;
+    size_t totalBytes = vector.size() * sizeof(double) * TRANSPORT_VECTORS;
+
+    std::cout << "TLS: " << TRANSPORT_VECTORS << " векторов x " << TRANSPORT_VECTOR_ELEMENTS
+              << " float64 через TCP loopback, прием и сумма кодом сессии\n";
+    std::cout << std::left << std::setw(10) << "mode" << std::right << std::setw(10) << "GB/s"
+              << "  check  crypto\n";
+
+    for (int mode = 0; mode < 2; mode++) {
+        int clientFd = -1;
+        int serverFd = -1;
+        if (!loopbackPair(clientFd, serverFd)) {
+            std::cerr << "Не удалось создать loopback-соединение\n";
+            return 1;
+        }
+
+        bool clientOk = false;
+        bool served = false;
+        std::string crypto = "-";
+        auto start = std::chrono::steady_clock::now();
+        std::thread client;
+        if (mode == 0) {
+            client = std::thread(streamClient, clientFd, std::cref(vector), expected, std::ref(clientOk));
+        } else {
+            client = std::thread(tlsClient, clientFd, std::cref(clientContext), std::cref(vector),
+                                 expected, std::ref(clientOk));
+        }
+        {
+            AsyncSocket socket(serverFd);
+            bool secured = mode == 0 ||
+                socket.startTls(serverContext.newSession(), Config::TLS_HANDSHAKE_TIMEOUT_MS).runBlocking();
+            served = secured && serveSum(socket, 0, false, TRANSPORT_VECTORS);
+            if (mode == 1) {
+                // Прием - основной поток данных: от него зависит, работает ли recv без копии в OpenSSL
+                crypto = std::string("recv=") + (socket.kernelTlsReceive() ? "kernel" : "openssl") +
+                         ", send=" + (socket.kernelTlsSend() ? "kernel" : "openssl");
+            }
+        }
+        client.join();
+        double seconds = secondsSince(start);
+        close(clientFd);
+        close(serverFd);
+
+        std::cout << std::left << std::setw(10) << (mode == 0 ? "plain" : "tls") << std::right
+                  << std::fixed << std::setprecision(2) << std::setw(10)
+                  << gbPerSecond(totalBytes, seconds) << "  " << std::setw(5)
+                  << (served && clientOk ? "ok" : "FAIL") << "  " << crypto << "\n";
+    }
+
+    std::cout << "Ядерный TLS требует модуля tls в ядре (/proc/sys/net/ipv4/tcp_available_ulp)\n";
+    return 0;
+}
+
+int Benchmark::qos() {
+    std::vector<double> bulkVector = randomSeries(TRANSPORT_VECTOR_ELEMENTS);
+
+    std::cout << "QoS: " << QOS_BULK_SESSIONS << " потоковых сессии (1 МБ векторы) и " << QOS_PROBES
+              << " коротких запросов (" << QOS_PROBE_ELEMENTS << " float64) в одном потоке исполнителя\n";
+    std::cout << std::left << std::setw(10) << "scheduler" << std::right << std::setw(10) << "p50 us"
+              << std::setw(10) << "p99 us" << std::setw(10) << "max us" << std::setw(12) << "bulk GB/s"
+              << "  check\n";
+
+    const char* names[] = {"none", "drr", "classes"};
+    for (int mode = 0; mode < 3; mode++) {
+        QosProfile bulkProfile;
+        QosProfile probeProfile;
+        if (mode == 2) {
+            bulkProfile.qos = QosClass::BULK;
+            probeProfile.qos = QosClass::INTERACTIVE;
+        }
+
+        Executor executor(1);
+        if (!executor.start(nullptr)) {
+            std::cerr << "Не удалось запустить исполнитель\n";
+            return 1;
+        }
+
+        std::atomic<int> finished(0);
+        std::atomic<bool> stop(false);
+        std::atomic<size_t> bulkBytes(0);
+        std::vector<int> clientFds;
+        std::vector<int> serverFds;
+        std::vector<std::thread> bulkThreads;
+
+        for (int i = 0; i <= QOS_BULK_SESSIONS; i++) {
+            int clientFd = -1;
+            int serverFd = -1;
+            if (!loopbackPair(clientFd, serverFd)) {
+                std::cerr << "Не удалось создать loopback-соединение\n";
+                return 1;
+            }
+            clientFds.push_back(clientFd);
+            serverFds.push_back(serverFd);
+        }
+
+        // Последнее соединение - интерактивный клиент, остальные - потоковые
+        for (int i = 0; i < QOS_BULK_SESSIONS; i++) {
+            executor.spawn(0, qosSession(serverFds[i], "bulk" + std::to_string(i), bulkProfile,
+                                         mode != 0, QOS_BULK_VECTORS, finished));
+            bulkThreads.emplace_back(bulkClient, clientFds[i], std::cref(bulkVector), std::cref(stop),
+                                     std::ref(bulkBytes));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        std::vector<double> latencies;
+        bool probeOk = false;
+        size_t bulkStart = bulkBytes;
+        auto start = std::chrono::steady_clock::now();
+        executor.spawn(0, qosSession(serverFds[QOS_BULK_SESSIONS], "probe", probeProfile,
+                                     mode != 0, QOS_PROBES, finished));
+        probeClient(clientFds[QOS_BULK_SESSIONS], latencies, probeOk);
+        double seconds = secondsSince(start);
+        size_t bulkDuring = bulkBytes - bulkStart;
+
+        // Потоковые сессии завершаются обрывом соединения
+        stop = true;
+        for (int i = 0; i < QOS_BULK_SESSIONS; i++) {
+            shutdown(clientFds[i], SHUT_RDWR);
+        }
+        for (std::thread& thread : bulkThreads) {
+            thread.join();
+        }
+        while (finished < QOS_BULK_SESSIONS + 1) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        executor.stop();
+        for (size_t i = 0; i < clientFds.size(); i++) {
+            close(clientFds[i]);
+            close(serverFds[i]);
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) {
+            return latencies.empty() ? 0.0 : latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+        };
+        std::cout << std::left << std::setw(10) << names[mode] << std::right << std::fixed
+                  << std::setprecision(0) << std::setw(10) << percentile(0.5) << std::setw(10)
+                  << percentile(0.99) << std::setw(10) << percentile(1.0) << std::setprecision(2)
+                  << std::setw(12) << gbPerSecond(bulkDuring, seconds) << "  "
+                  << (probeOk ? "ok" : "FAIL") << "\n";
+    }
+
+    std::cout << "none - сессии без очереди; drr - все логины STANDARD с весом 1; "
+              << "classes - запросы INTERACTIVE, потоки BULK\n";
+    return 0;
+}
+
+int Benchmark::trace() {
+    std::cout << "Бортовой самописец: " << TRACE_BENCH_STAGES << " этапов (begin + end) в одном потоке, "
+              << "кольцо " << Config::TRACE_RING_EVENTS << " событий\n";
+    std::cout << std::left << std::setw(10) << "recorder" << std::right << std::setw(12) << "ns/stage"
+              << "\n";
+
+    // Выключенный самописец - только время вызова и nop точки USDT
+    volatile uint64_t sink = 0;
+    for (int mode = 0; mode < 2; mode++) {
+        FlightRecorder::setEnabled(mode == 1);
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < TRACE_BENCH_STAGES; i++) {
+            uint64_t started = FlightRecorder::begin(TraceStage::COMPUTE, i);
+            FlightRecorder::end(TraceStage::COMPUTE, i, started, i);
+            sink = sink + started;
+        }
+        std::cout << std::left << std::setw(10) << (mode == 1 ? "on" : "off") << std::right
+                  << std::fixed << std::setprecision(1) << std::setw(12)
+                  << secondsSince(start) * 1e9 / TRACE_BENCH_STAGES << "\n";
+    }
+    FlightRecorder::setEnabled(true);
+
+    // Чтение во время записи: каждое прочитанное событие должно быть целым.
+    // Писатель кладет в событие номер, из которого выводятся остальные поля
+    std::atomic<bool> stop(false);
+    std::thread writer([&stop] {
+        for (uint64_t i = 1; !stop; i++) {
+            FlightRecorder::end(TraceStage::FLUSH, i, i, i * 3);
+        }
+    });
+
+    size_t checked = 0;
+    size_t torn = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < TRACE_BENCH_SNAPSHOTS; i++) {
+        for (const TraceEvent& event : FlightRecorder::snapshot()) {
+            if (event.stage != TraceStage::FLUSH) {
+                continue;
+            }
+            checked++;
+            if (event.arg != event.session * 3 || event.startNs != event.session) {
+                torn++;
+            }
+        }
+        std::this_thread::yield();
+    }
+    double snapshotMs = secondsSince(start) * 1e3 / TRACE_BENCH_SNAPSHOTS;
+    stop = true;
+    writer.join();
+
+    std::string path = "/tmp/vcalc_trace_bench." + std::to_string(getpid()) + ".json";
+    start = std::chrono::steady_clock::now();
+    long events = FlightRecorder::dump(path);
+    double dumpMs = secondsSince(start) * 1e3;
+    struct stat info;
+    double dumpMb = stat(path.c_str(), &info) == 0 ? info.st_size / 1e6 : 0.0;
+    unlink(path.c_str());
+
+    std::cout << "Чтение во время записи: " << std::setprecision(2) << snapshotMs << " мс на снимок, "
+              << checked << " событий, check " << (torn == 0 && checked > 0 ? "ok" : "FAIL") << "\n";
+    std::cout << "Дамп: " << events << " событий, " << dumpMb << " МБ, " << dumpMs << " мс\n";
+    return torn == 0 && checked > 0 && events > 0 ? 0 : 1;
+}
+
+int Benchmark::exact() {
+    const size_t sizes[] = {4096, 1048576};
+
+    std::cout << "Точная сумма float64 (FLAG_EXACT) против SIMD-суммы и Кэхэна, ГБ/с\n";
+    std::cout << std::left << std::setw(10) << "data" << std::right << std::setw(10) << "elements"
+              << std::setw(9) << "simd" << std::setw(9) << "kahan" << std::setw(9) << "exact"
+              << std::setw(12) << "simd/exact" << std::setw(13) << "kahan error"
+              << "  check\n";
+
+    bool allOk = true;
+    volatile double sink = 0;
+    for (int dataset = 0; dataset < 2; dataset++) {
+        for (size_t count : sizes) {
+            double expected = 0;
+            std::vector<double> data = dataset == 0 ? randomSeries(count) : cancellingSeries(count, expected);
+            const uint8_t* raw = reinterpret_cast<const uint8_t*>(data.data());
+            size_t bytes = count * sizeof(double);
+
+            double simd = nanosPerCall(bytes, [&] {
+                sink = sink + simdSum(data.data(), count);
+            });
+            double kahan = nanosPerCall(bytes, [&] {
+                sink = sink + VectorProcessor::sumTyped(ElementType::FLOAT64, raw, count, false).real;
+            });
+            double exactNs = nanosPerCall(bytes, [&] {
+                sink = sink + VectorProcessor::sumTyped(ElementType::FLOAT64, raw, count, false, true).real;
+            });
+
+            // Воспроизводимость: другой порядок и сумма по частям через merge
+            // дают те же биты, что и весь вектор целиком
+            double whole = VectorProcessor::sumTyped(ElementType::FLOAT64, raw, count, false, true).real;
+            std::vector<double> shuffled = data;
+            std::mt19937_64 gen(count);
+            std::shuffle(shuffled.begin(), shuffled.end(), gen);
+
+            std::vector<size_t> cuts;
+            for (int i = 0; i < EXACT_BENCH_PARTITIONS - 1; i++) {
+                cuts.push_back(std::uniform_int_distribution<size_t>(0, count)(gen));
+            }
+            cuts.push_back(0);
+            cuts.push_back(count);
+            std::sort(cuts.begin(), cuts.end());
+
+            ExactSum merged;
+            merged.clear();
+            for (size_t i = 0; i + 1 < cuts.size(); i++) {
+                ExactSum part;
+                part.clear();
+                part.add(shuffled.data() + cuts[i], cuts[i + 1] - cuts[i]);
+                merged.merge(part);
+            }
+
+            double kahanSum = VectorProcessor::sumTyped(ElementType::FLOAT64, raw, count, false).real;
+            bool ok = sameBits(whole, merged.round()) && (dataset == 0 || whole == expected);
+            allOk = allOk && ok;
+
+            std::cout << std::left << std::setw(10) << (dataset == 0 ? "random" : "cancelling")
+                      << std::right << std::setw(10) << count << std::fixed << std::setprecision(2)
+                      << std::setw(9) << bytes / simd << std::setw(9) << bytes / kahan
+                      << std::setw(9) << bytes / exactNs << std::setw(12) << exactNs / simd
+                      << std::setw(13) << std::scientific << std::setprecision(1)
+                      << std::fabs(kahanSum - whole) / std::max(std::fabs(whole), 1.0)
+                      << std::defaultfloat << "  " << (ok ? "ok" : "FAIL") << "\n";
+        }
+    }
+
+    std::cout << "kahan error - относительно точной суммы; check - точная сумма совпадает "
+              << "побитно после перемешивания и сложения " << EXACT_BENCH_PARTITIONS << " частей\n";
+    return allOk ? 0 : 1;
+}
@@ -1,4 +1,5 @@
 #include "ClientDB.h"
+#include "Config.h"
 #include <fstream>
 #include <sstream>
 #include <random>
@@ -19,6 +20,7 @@ bool ClientDB::loadFromFile() {
     }
     
     clients.clear();
+    profiles.clear();
     std::string line;
     
     while (std::getline(file, line)) {
@@ -30,16 +32,22 @@ bool ClientDB::loadFromFile() {
         size_t delimiterPos = line.find(':');
         if (delimiterPos != std::string::npos) {
             std::string login = line.substr(0, delimiterPos);
-            std::string passwordHash = line.substr(delimiterPos + 1);
+            std::string entry = line.substr(delimiterPos + 1);
             
             // Удаляем пробелы
             login.erase(0, login.find_first_not_of(" \t"));
             login.erase(login.find_last_not_of(" \t") + 1);
-            passwordHash.erase(0, passwordHash.find_first_not_of(" \t"));
-            passwordHash.erase(passwordHash.find_last_not_of(" \t") + 1);
+            entry.erase(0, entry.find_first_not_of(" \t"));
+            entry.erase(entry.find_last_not_of(" \t") + 1);
             
-            if (!login.empty() && !passwordHash.empty()) {
+            std::string passwordHash;
+            QosProfile profile;
+            bool hasProfile = false;
+            if (!login.empty() && parseEntry(entry, passwordHash, profile, hasProfile)) {
                 clients[login] = passwordHash;
+                if (hasProfile) {
+                    profiles[login] = profile;
+                }
             }
         }
     }
@@ -57,10 +65,17 @@ bool ClientDB::saveToFile() {
     }
     
     file << "# База клиентов векторного калькулятора\n";
-    file << "# Формат: логин:хэш_пароля\n\n";
+    file << "# Формат: логин:хэш_пароля[:класс[:вес[:cpu_мс_в_секунду]]]\n";
+    file << "# Классы: interactive, standard, bulk\n\n";
     
     for (const auto& [login, hash] : clients) {
-        file << login << ":" << hash << "\n";
+        file << login << ":" << hash;
+        auto profile = profiles.find(login);
+        if (profile != profiles.end()) {
+            file << ":" << FairScheduler::className(profile->second.qos)
+                 << ":" << profile->second.weight << ":" << profile->second.cpuMsPerSec;
+        }
+        file << "\n";
     }
     
     file.close();
@@ -83,6 +98,73 @@ bool ClientDB::verifyPassword(const std::string& login, const std::string& passw
     return it->second == passwordHash;
 }
 
+QosProfile ClientDB::getProfile(const std::string& login) const {
+    std::lock_guard<std::mutex> lock(dbMutex);
+    
+    auto it = profiles.find(login);
+    return it != profiles.end() ? it->second : QosProfile();
+}
+
+bool ClientDB::parseEntry(const std::string& entry, std::string& password,
+                          QosProfile& profile, bool& hasProfile) {
+    // Класс ищем как можно левее среди трех последних полей: все поля
+    // после него - числа (вес, бюджет CPU). Поля режутся только с правого
+    // края, пароль перед ними остается как есть
+    hasProfile = false;
+    password = entry;
+    
+    for (size_t suffixFields = 3; suffixFields >= 1; suffixFields--) {
+        size_t split = entry.size();
+        for (size_t i = 0; i < suffixFields && split != std::string::npos && split > 0; i++) {
+            split = entry.rfind(':', split - 1);
+        }
+        if (split == std::string::npos || split == 0) {
+            continue;
+        }
+        
+        std::vector<std::string> fields;
+        std::istringstream fieldStream(entry.substr(split + 1));
+        std::string field;
+        while (std::getline(fieldStream, field, ':')) {
+            field.erase(0, field.find_first_not_of(" \t\r"));
+            field.erase(field.find_last_not_of(" \t\r") + 1);
+            fields.push_back(field);
+        }
+        
+        QosClass qos;
+        if (fields.size() != suffixFields || !FairScheduler::parseClass(fields[0], qos)) {
+            continue;
+        }
+        bool numeric = true;
+        for (size_t j = 1; j < fields.size(); j++) {
+            numeric = numeric && !fields[j].empty() &&
+                      fields[j].find_first_not_of("0123456789") == std::string::npos &&
+                      fields[j].size() <= 9;
+        }
+        if (!numeric) {
+            continue;
+        }
+        
+        profile.qos = qos;
+        if (fields.size() > 1) {
+            profile.weight = static_cast<uint32_t>(std::stoul(fields[1]));
+        }
+        if (fields.size() > 2) {
+            profile.cpuMsPerSec = static_cast<uint32_t>(std::stoul(fields[2]));
+        }
+        if (profile.weight == 0 || profile.weight > Config::SCHED_MAX_WEIGHT ||
+            profile.cpuMsPerSec > static_cast<uint32_t>(Config::SCHED_BUDGET_WINDOW_MS)) {
+            return false;
+        }
+        
+        hasProfile = true;
+        password = entry.substr(0, split);
+        break;
+    }
+    
+    return !password.empty();
+}
+
 std::string ClientDB::generateHash(const std::string& salt, const std::string& password) {
     // SHA-1 согласно ТЗ
     std::string input = salt + password;
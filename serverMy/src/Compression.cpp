@@ -0,0 +1,293 @@
+#include "Compression.h"
+#include <cstring>
+
+namespace {
+    // Параметры формата блока LZ4
+    const size_t MIN_MATCH = 4;
+    const size_t LAST_LITERALS = 5;   // последние 5 байт всегда литералы
+    const size_t MF_LIMIT = 12;       // совпадение не начинается ближе 12 байт к концу
+    const size_t MAX_OFFSET = 65535;
+    const int HASH_BITS = 13;
+
+    inline uint32_t read32(const uint8_t* p) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint32_t hash32(uint32_t v) {
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    inline uint64_t loadWord(const uint8_t* p, size_t elemSize) {
+        if (elemSize == sizeof(uint32_t)) {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline void storeWord(uint8_t* p, size_t elemSize, uint64_t v) {
+        if (elemSize == sizeof(uint32_t)) {
+            uint32_t w = static_cast<uint32_t>(v);
+            memcpy(p, &w, sizeof(w));
+        } else {
+            memcpy(p, &v, sizeof(v));
+        }
+    }
+
+    // Длина >= 15 кодируется продолжением из байтов 255
+    uint8_t* writeLength(uint8_t* op, size_t length) {
+        while (length >= 255) {
+            *op++ = 255;
+            length -= 255;
+        }
+        *op++ = static_cast<uint8_t>(length);
+        return op;
+    }
+
+    bool readLength(const uint8_t* src, size_t srcSize, size_t& ip, size_t& length) {
+        uint8_t b;
+        do {
+            if (ip >= srcSize) {
+                return false;
+            }
+            b = src[ip++];
+            length += b;
+        } while (b == 255);
+        return true;
+    }
+
+    uint8_t* writeSequence(uint8_t* op, const uint8_t* literals, size_t literalLength,
+                           size_t offset, size_t matchLength) {
+        uint8_t* token = op++;
+        *token = static_cast<uint8_t>((literalLength >= 15 ? 15 : literalLength) << 4);
+        if (literalLength >= 15) {
+            op = writeLength(op, literalLength - 15);
+        }
+        memcpy(op, literals, literalLength);
+        op += literalLength;
+
+        if (matchLength == 0) {
+            return op;  // последняя последовательность - только литералы
+        }
+
+        *op++ = static_cast<uint8_t>(offset & 0xFF);
+        *op++ = static_cast<uint8_t>(offset >> 8);
+
+        size_t code = matchLength - MIN_MATCH;
+        *token |= static_cast<uint8_t>(code >= 15 ? 15 : code);
+        if (code >= 15) {
+            op = writeLength(op, code - 15);
+        }
+        return op;
+    }
+}
+
+bool Compression::isValidMode(uint8_t mode) {
+    if (mode & ~(TRANSFORM_MASK | FLAG_LZ4)) {
+        return false;
+    }
+    return (mode & TRANSFORM_MASK) <= static_cast<uint8_t>(CompressionMode::XOR_DELTA);
+}
+
+void Compression::shuffle(const uint8_t* src, uint8_t* dst, size_t count, size_t elemSize) {
+    for (size_t j = 0; j < elemSize; j++) {
+        uint8_t* plane = dst + j * count;
+        for (size_t i = 0; i < count; i++) {
+            plane[i] = src[i * elemSize + j];
+        }
+    }
+}
+
+void Compression::unshuffle(const uint8_t* src, uint8_t* dst, size_t count, size_t elemSize) {
+    for (size_t j = 0; j < elemSize; j++) {
+        const uint8_t* plane = src + j * count;
+        for (size_t i = 0; i < count; i++) {
+            dst[i * elemSize + j] = plane[i];
+        }
+    }
+}
+
+void Compression::xorDeltaEncode(uint8_t* data, size_t count, size_t elemSize, uint64_t& prev) {
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = loadWord(data + i * elemSize, elemSize);
+        storeWord(data + i * elemSize, elemSize, value ^ prev);
+        prev = value;
+    }
+}
+
+void Compression::xorDeltaDecode(uint8_t* data, size_t count, size_t elemSize, uint64_t& prev) {
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = loadWord(data + i * elemSize, elemSize) ^ prev;
+        storeWord(data + i * elemSize, elemSize, value);
+        prev = value;
+    }
+}
+
+size_t Compression::lz4Bound(size_t srcSize) {
+    return srcSize + srcSize / 255 + 16;
+}
+
+size_t Compression::lz4Compress(const uint8_t* src, size_t srcSize, uint8_t* dst) {
+    uint8_t* op = dst;
+    size_t anchor = 0;
+
+    if (srcSize > MF_LIMIT) {
+        // Позиция+1 последнего вхождения 4-байтовой последовательности (0 - пусто)
+        uint32_t table[1 << HASH_BITS];
+        memset(table, 0, sizeof(table));
+
+        const size_t matchLimit = srcSize - MF_LIMIT;
+        const size_t matchEnd = srcSize - LAST_LITERALS;
+        size_t ip = 0;
+        size_t misses = 0;  // как в LZ4: на несжимаемых данных шаг поиска растет
+
+        while (ip < matchLimit) {
+            uint32_t sequence = read32(src + ip);
+            uint32_t h = hash32(sequence);
+            size_t candidate = table[h];
+            table[h] = static_cast<uint32_t>(ip + 1);
+
+            if (candidate == 0 || ip - (candidate - 1) > MAX_OFFSET ||
+                read32(src + candidate - 1) != sequence) {
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+
+            size_t ref = candidate - 1;
+            size_t length = MIN_MATCH;
+            while (ip + length < matchEnd && src[ref + length] == src[ip + length]) {
+                length++;
+            }
+
+            op = writeSequence(op, src + anchor, ip - anchor, ip - ref, length);
+            ip += length;
+            anchor = ip;
+        }
+    }
+
+    op = writeSequence(op, src + anchor, srcSize - anchor, 0, 0);
+    return static_cast<size_t>(op - dst);
+}
+
+bool Compression::lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < srcSize) {
+        uint8_t token = src[ip++];
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(src, srcSize, ip, literalLength)) {
+            return false;
+        }
+        if (literalLength > srcSize - ip || literalLength > dstSize - op) {
+            return false;
+        }
+        memcpy(dst + op, src + ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        if (ip == srcSize) {
+            break;  // последняя последовательность
+        }
+
+        if (srcSize - ip < 2) {
+            return false;
+        }
+        size_t offset = src[ip] | (static_cast<size_t>(src[ip + 1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) {
+            return false;
+        }
+
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !readLength(src, srcSize, ip, matchLength)) {
+            return false;
+        }
+        matchLength += MIN_MATCH;
+        if (matchLength > dstSize - op) {
+            return false;
+        }
+
+        // Совпадение может перекрывать само себя - копируем побайтно
+        const uint8_t* match = dst + op - offset;
+        if (offset >= matchLength) {
+            memcpy(dst + op, match, matchLength);
+        } else {
+            for (size_t i = 0; i < matchLength; i++) {
+                dst[op + i] = match[i];
+            }
+        }
+        op += matchLength;
+    }
+
+    return op == dstSize;
+}
+
+void Compression::encodeBlock(const uint8_t* raw, size_t rawBytes, size_t elemSize, uint8_t mode,
+                              uint64_t& prev, std::vector<uint8_t>& encoded) {
+    size_t count = rawBytes / elemSize;
+    CompressionMode transform = static_cast<CompressionMode>(mode & TRANSFORM_MASK);
+
+    std::vector<uint8_t> transformed(rawBytes);
+    if (transform == CompressionMode::NONE) {
+        memcpy(transformed.data(), raw, rawBytes);
+    } else if (transform == CompressionMode::SHUFFLE) {
+        shuffle(raw, transformed.data(), count, elemSize);
+    } else {
+        std::vector<uint8_t> delta(raw, raw + rawBytes);
+        xorDeltaEncode(delta.data(), count, elemSize, prev);
+        shuffle(delta.data(), transformed.data(), count, elemSize);
+    }
+
+    if (mode & FLAG_LZ4) {
+        encoded.resize(lz4Bound(rawBytes));
+        size_t size = lz4Compress(transformed.data(), rawBytes, encoded.data());
+        if (size < rawBytes) {
+            encoded.resize(size);
+            return;
+        }
+    }
+
+    encoded.swap(transformed);
+}
+
+bool Compression::decodeBlock(const uint8_t* encoded, size_t encodedBytes, size_t rawBytes,
+                              size_t elemSize, uint8_t mode, uint64_t& prev,
+                              std::vector<uint8_t>& scratch, uint8_t* raw) {
+    size_t count = rawBytes / elemSize;
+    CompressionMode transform = static_cast<CompressionMode>(mode & TRANSFORM_MASK);
+    const uint8_t* source = encoded;
+
+    // encodedBytes == rawBytes означает блок, переданный без LZ4
+    if (encodedBytes != rawBytes) {
+        if (!(mode & FLAG_LZ4) || encodedBytes > rawBytes) {
+            return false;
+        }
+        if (transform == CompressionMode::NONE) {
+            return lz4Decompress(encoded, encodedBytes, raw, rawBytes);
+        }
+        scratch.resize(rawBytes);
+        if (!lz4Decompress(encoded, encodedBytes, scratch.data(), rawBytes)) {
+            return false;
+        }
+        source = scratch.data();
+    }
+
+    if (transform == CompressionMode::NONE) {
+        memcpy(raw, source, rawBytes);
+        return true;
+    }
+
+    unshuffle(source, raw, count, elemSize);
+    if (transform == CompressionMode::XOR_DELTA) {
+        xorDeltaDecode(raw, count, elemSize, prev);
+    }
+    return true;
+}
@@ -0,0 +1,447 @@
+#include "ExactSum.h"
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <algorithm>
+
+namespace {
+    __extension__ typedef unsigned __int128 uint128_t;
+
+    const int EXPONENT_BITS = 11;
+    const int MANTISSA_BITS = 52;
+    const uint64_t MANTISSA_MASK = (1ull << MANTISSA_BITS) - 1;
+    const uint32_t SPECIAL_EXPONENT = (1u << EXPONENT_BITS) - 1;  // inf и NaN
+    const int KEYS = 1 << (EXPONENT_BITS + 1);                    // знак и порядок
+
+    // Блок: ни одна ячейка таблицы не получит больше BLOCK мантисс < 2^53,
+    // поэтому uint64 не переполняется без счетчиков на каждое сложение
+    const size_t BLOCK = 2048;
+    static_assert(BLOCK <= (1ull << (64 - MANTISSA_BITS - 1)), "мантиссы блока должны помещаться в uint64");
+
+    // Независимые таблицы для соседних элементов: одинаковые порядки подряд
+    // не выстраиваются в цепочку сложений через одну ячейку памяти
+    const int LANES = 4;
+
+    // Нормализация не реже, чем через столько прибавлений (каждое < 2^32)
+    const uint32_t NORMALIZE_AFTER = 1u << 30;
+
+    // Большой сумматор: ячейка на каждое сочетание знака и порядка.
+    // Между блоками все ячейки нулевые
+    struct LargeTable {
+        uint64_t sums[LANES][KEYS];
+        uint32_t keys[BLOCK];
+        uint64_t mantissas[BLOCK];
+    };
+
+    LargeTable& threadTable() {
+        // 150 КБ на поток - только в потоках, где точная сумма понадобилась
+        thread_local std::unique_ptr<LargeTable> table;
+        if (!table) {
+            table.reset(new LargeTable());
+        }
+        return *table;
+    }
+
+    uint64_t bitsOf(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // Быстрый путь для блока с узким разбросом порядков (извлечение по
+    // уровням, как в ReproBLAS). Уровень l - сумматор S = 1.5 * 2^k_l:
+    // t = S + x округляет x до кратного ulp(S) = 2^(k_l - 52), и эта часть
+    // (t - S) точна, а остаток x - (t - S) переходит на следующий уровень.
+    // Уровни отстоят на BIN_STEP бит, поэтому остаток меньше ulp уровня и
+    // целиком ложится на следующий; последний уровень только складывает -
+    // все слагаемые там кратны его ulp. Запас BIN_HEADROOM бит над
+    // старшим элементом держит S в [2^k, 2^(k+1)) на всем блоке, и S - C
+    // каждой дорожки тоже точно
+    const int BIN_STEP = 40;
+    const int BIN_HEADROOM = 13;
+    const int MAX_BIN_LEVELS = 3;
+    const int BIN_LANES = 8;   // два вектора по 4 double на уровень
+    static_assert(BLOCK / BIN_LANES + BIN_LANES < (1u << (BIN_HEADROOM - 2)),
+                  "сумма дорожки должна оставаться в двоичном интервале уровня");
+
+    // Векторы GCC: на базовом x86-64 - пары SSE2, с target("avx2") - ymm,
+    // на других архитектурах - то, что умеет компилятор
+    typedef double Lanes __attribute__((vector_size(32)));
+    typedef int64_t LaneMask __attribute__((vector_size(32)));
+
+    template <int LEVELS>
+    __attribute__((always_inline)) inline
+    void binnedLevels(const double* data, size_t count, const double* bins, double* partials) {
+        Lanes sums[LEVELS][2];
+        for (int l = 0; l < LEVELS; l++) {
+            sums[l][0] = Lanes{} + bins[l];
+            sums[l][1] = sums[l][0];
+        }
+
+        size_t i = 0;
+        for (; i + BIN_LANES <= count; i += BIN_LANES) {
+            Lanes x0, x1;
+            std::memcpy(&x0, data + i, sizeof(x0));
+            std::memcpy(&x1, data + i + 4, sizeof(x1));
+            for (int l = 0; l < LEVELS - 1; l++) {
+                Lanes t0 = sums[l][0] + x0;
+                Lanes t1 = sums[l][1] + x1;
+                x0 -= t0 - sums[l][0];
+                x1 -= t1 - sums[l][1];
+                sums[l][0] = t0;
+                sums[l][1] = t1;
+            }
+            sums[LEVELS - 1][0] += x0;
+            sums[LEVELS - 1][1] += x1;
+        }
+        // Хвост - в первую дорожку; нули в остальных не меняют S
+        for (; i < count; i++) {
+            Lanes x = Lanes{};
+            x[0] = data[i];
+            for (int l = 0; l < LEVELS - 1; l++) {
+                Lanes t = sums[l][0] + x;
+                x -= t - sums[l][0];
+                sums[l][0] = t;
+            }
+            sums[LEVELS - 1][0] += x;
+        }
+
+        for (int l = 0; l < LEVELS; l++) {
+            Lanes low = sums[l][0] - bins[l];
+            Lanes high = sums[l][1] - bins[l];
+            std::memcpy(partials + l * BIN_LANES, &low, sizeof(low));
+            std::memcpy(partials + l * BIN_LANES + 4, &high, sizeof(high));
+        }
+    }
+
+    // Число уровней и точные частичные суммы в partials (BIN_LANES на уровень);
+    // -1 - нужен путь через таблицу порядков (inf, NaN,
+    // порядки у границы диапазона или разброс шире MAX_BIN_LEVELS уровней)
+    __attribute__((always_inline)) inline
+    int binnedBlock(const double* data, size_t count, double* partials) {
+        // Разброс порядков: наибольший модуль и наименьший ненулевой
+        const LaneMask absMask = LaneMask{} + 0x7FFFFFFFFFFFFFFFll;
+        const Lanes inf = Lanes{} + std::numeric_limits<double>::infinity();
+        Lanes largest = Lanes{};
+        Lanes smallest = inf;
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            Lanes x;
+            std::memcpy(&x, data + i, sizeof(x));
+            Lanes magnitude = reinterpret_cast<Lanes>(reinterpret_cast<LaneMask>(x) & absMask);
+            largest = magnitude > largest ? magnitude : largest;
+            Lanes nonzero = magnitude == 0 ? inf : magnitude;
+            smallest = nonzero < smallest ? nonzero : smallest;
+        }
+        double maxAbs = 0;
+        double minAbs = std::numeric_limits<double>::infinity();
+        for (int lane = 0; lane < 4; lane++) {
+            maxAbs = std::max(maxAbs, largest[lane]);
+            minAbs = std::min(minAbs, smallest[lane]);
+        }
+        for (; i < count; i++) {
+            double magnitude = std::fabs(data[i]);
+            maxAbs = magnitude > maxAbs ? magnitude : maxAbs;
+            minAbs = magnitude != 0 && magnitude < minAbs ? magnitude : minAbs;
+        }
+
+        // NaN сравнения пропускают - он проявится в частичных суммах.
+        // Блок из нулей (или только из NaN) - тоже через таблицу, он редок
+        if (maxAbs == 0) {
+            return -1;
+        }
+        int top = std::ilogb(maxAbs) + BIN_HEADROOM;
+        if (maxAbs == std::numeric_limits<double>::infinity() ||
+            top > std::numeric_limits<double>::max_exponent - 1) {
+            return -1;
+        }
+        // Все элементы кратны 2^lowestUlp; уровней - пока ulp не опустится до него
+        int lowestUlp = std::max(std::ilogb(minAbs), std::numeric_limits<double>::min_exponent - 1) - MANTISSA_BITS;
+        int spread = top - MANTISSA_BITS - lowestUlp;
+        int levels = spread <= 0 ? 1 : 1 + (spread + BIN_STEP - 1) / BIN_STEP;
+        if (levels > MAX_BIN_LEVELS) {
+            return -1;
+        }
+
+        double bins[MAX_BIN_LEVELS];
+        for (int l = 0; l < levels; l++) {
+            // Нижний уровень может уйти под нормальные числа - ulp 2^-1074 ему достаточно
+            int exponent = std::max(top - BIN_STEP * l, std::numeric_limits<double>::min_exponent - 1);
+            bins[l] = std::ldexp(1.5, exponent);
+        }
+        switch (levels) {
+            case 1: binnedLevels<1>(data, count, bins, partials); break;
+            case 2: binnedLevels<2>(data, count, bins, partials); break;
+            default: binnedLevels<3>(data, count, bins, partials); break;
+        }
+
+        for (int j = 0; j < levels * BIN_LANES; j++) {
+            if (partials[j] != partials[j]) {
+                return -1;
+            }
+        }
+        return levels;
+    }
+
+    int binnedBlockPlain(const double* data, size_t count, double* partials) {
+        return binnedBlock(data, count, partials);
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __attribute__((target("avx2")))
+    int binnedBlockAvx2(const double* data, size_t count, double* partials) {
+        return binnedBlock(data, count, partials);
+    }
+
+    const bool hasAvx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    int bitLength(uint128_t value) {
+        uint64_t high = static_cast<uint64_t>(value >> 64);
+        if (high != 0) {
+            return 128 - __builtin_clzll(high);
+        }
+        uint64_t low = static_cast<uint64_t>(value);
+        return low != 0 ? 64 - __builtin_clzll(low) : 0;
+    }
+}
+
+void ExactSum::clear() {
+    std::memset(chunks, 0, sizeof(chunks));
+    pending = 0;
+    nan = false;
+    positiveInf = false;
+    negativeInf = false;
+}
+
+void ExactSum::addScaled(uint64_t magnitude, int position, bool negative) {
+    if (pending >= NORMALIZE_AFTER) {
+        normalize(chunks);
+        pending = 0;
+    }
+    pending++;
+
+    // Сдвиг внутри цифры - до 31 бита: 64-битное слагаемое занимает три цифры
+    int index = position / CHUNK_BITS;
+    uint128_t shifted = static_cast<uint128_t>(magnitude) << (position % CHUNK_BITS);
+    int64_t digit0 = static_cast<int64_t>(static_cast<uint32_t>(shifted));
+    int64_t digit1 = static_cast<int64_t>(static_cast<uint32_t>(shifted >> 32));
+    int64_t digit2 = static_cast<int64_t>(static_cast<uint64_t>(shifted >> 64));
+    if (negative) {
+        chunks[index] -= digit0;
+        chunks[index + 1] -= digit1;
+        chunks[index + 2] -= digit2;
+    } else {
+        chunks[index] += digit0;
+        chunks[index + 1] += digit1;
+        chunks[index + 2] += digit2;
+    }
+}
+
+void ExactSum::normalize(int64_t* digits) {
+    // Младшие цифры - в [0, 2^32), знак и остаток переносов - в старшей
+    for (int i = 0; i < CHUNKS - 1; i++) {
+        int64_t carry = digits[i] >> CHUNK_BITS;
+        digits[i] -= carry * (static_cast<int64_t>(1) << CHUNK_BITS);
+        digits[i + 1] += carry;
+    }
+}
+
+void ExactSum::addBlock(const double* block, size_t length) {
+    double partials[MAX_BIN_LEVELS * BIN_LANES];
+#if defined(__x86_64__) || defined(__i386__)
+    int levels = hasAvx2 ? binnedBlockAvx2(block, length, partials) : binnedBlockPlain(block, length, partials);
+#else
+    int levels = binnedBlockPlain(block, length, partials);
+#endif
+    if (levels >= 0) {
+        for (int i = 0; i < levels * BIN_LANES; i++) {
+            add(partials[i]);
+        }
+        return;
+    }
+
+    LargeTable& table = threadTable();
+
+    // Разбор на ключ (знак и порядок) и мантиссу - без ветвлений, векторизуется.
+    // Скрытая единица есть у всех порядков, кроме 0 (субнормальные)
+    uint32_t lowest = SPECIAL_EXPONENT;
+    uint32_t highest = 0;
+    for (size_t i = 0; i < length; i++) {
+        uint64_t bits = bitsOf(block[i]);
+        uint32_t key = static_cast<uint32_t>(bits >> MANTISSA_BITS);
+        uint32_t exponent = key & SPECIAL_EXPONENT;
+        uint64_t hidden = static_cast<uint64_t>((exponent + SPECIAL_EXPONENT) >> EXPONENT_BITS);
+        table.keys[i] = key;
+        table.mantissas[i] = (bits & MANTISSA_MASK) | (hidden << MANTISSA_BITS);
+        lowest = std::min(lowest, exponent);
+        highest = std::max(highest, exponent);
+    }
+
+    // inf и NaN не суммируются: только флаги
+    if (highest == SPECIAL_EXPONENT) {
+        for (size_t i = 0; i < length; i++) {
+            if ((table.keys[i] & SPECIAL_EXPONENT) != SPECIAL_EXPONENT) {
+                continue;
+            }
+            if ((table.mantissas[i] & MANTISSA_MASK) != 0) {
+                nan = true;
+            } else if (table.keys[i] >> EXPONENT_BITS) {
+                negativeInf = true;
+            } else {
+                positiveInf = true;
+            }
+            table.mantissas[i] = 0;
+        }
+    }
+
+    // Одно сложение на элемент: мантисса в ячейку своего знака и порядка
+    size_t i = 0;
+    for (; i + LANES <= length; i += LANES) {
+        table.sums[0][table.keys[i]] += table.mantissas[i];
+        table.sums[1][table.keys[i + 1]] += table.mantissas[i + 1];
+        table.sums[2][table.keys[i + 2]] += table.mantissas[i + 2];
+        table.sums[3][table.keys[i + 3]] += table.mantissas[i + 3];
+    }
+    for (; i < length; i++) {
+        table.sums[0][table.keys[i]] += table.mantissas[i];
+    }
+
+    // Сброс в малый сумматор - только встретившиеся в блоке порядки
+    for (uint32_t exponent = lowest; exponent <= highest; exponent++) {
+        // Субнормальные и числа с порядком 1 имеют один масштаб 2^-1074
+        int position = exponent == 0 ? 0 : static_cast<int>(exponent) - 1;
+        for (uint32_t sign = 0; sign < 2; sign++) {
+            uint32_t key = (sign << EXPONENT_BITS) | exponent;
+            for (int lane = 0; lane < LANES; lane++) {
+                uint64_t sum = table.sums[lane][key];
+                if (sum != 0) {
+                    table.sums[lane][key] = 0;
+                    if (exponent != SPECIAL_EXPONENT) {
+                        addScaled(sum, position, sign != 0);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void ExactSum::add(const double* data, size_t count) {
+    for (size_t start = 0; start < count; start += BLOCK) {
+        addBlock(data + start, std::min(BLOCK, count - start));
+    }
+}
+
+// float точно представим в double: блок переводится и суммируется как double
+void ExactSum::add(const float* data, size_t count) {
+    double converted[BLOCK];
+    for (size_t start = 0; start < count; start += BLOCK) {
+        size_t length = std::min(BLOCK, count - start);
+        for (size_t i = 0; i < length; i++) {
+            converted[i] = data[start + i];
+        }
+        addBlock(converted, length);
+    }
+}
+
+void ExactSum::add(double value) {
+    uint64_t bits = bitsOf(value);
+    uint32_t exponent = static_cast<uint32_t>(bits >> MANTISSA_BITS) & SPECIAL_EXPONENT;
+    bool negative = (bits >> 63) != 0;
+    uint64_t mantissa = bits & MANTISSA_MASK;
+
+    if (exponent == SPECIAL_EXPONENT) {
+        if (mantissa != 0) {
+            nan = true;
+        } else if (negative) {
+            negativeInf = true;
+        } else {
+            positiveInf = true;
+        }
+        return;
+    }
+    if (exponent != 0) {
+        mantissa |= 1ull << MANTISSA_BITS;
+    }
+    if (mantissa != 0) {
+        addScaled(mantissa, exponent == 0 ? 0 : static_cast<int>(exponent) - 1, negative);
+    }
+}
+
+void ExactSum::merge(const ExactSum& other) {
+    // После нормализации обеих сторон каждая цифра меньше 2^32 по модулю
+    int64_t digits[CHUNKS];
+    std::memcpy(digits, other.chunks, sizeof(digits));
+    normalize(digits);
+    normalize(chunks);
+
+    for (int i = 0; i < CHUNKS; i++) {
+        chunks[i] += digits[i];
+    }
+    pending = 2;
+    nan = nan || other.nan;
+    positiveInf = positiveInf || other.positiveInf;
+    negativeInf = negativeInf || other.negativeInf;
+}
+
+double ExactSum::round() const {
+    if (nan || (positiveInf && negativeInf)) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    if (positiveInf) {
+        return std::numeric_limits<double>::infinity();
+    }
+    if (negativeInf) {
+        return -std::numeric_limits<double>::infinity();
+    }
+
+    int64_t digits[CHUNKS];
+    std::memcpy(digits, chunks, sizeof(digits));
+    normalize(digits);
+
+    // Отрицательная сумма: округляем модуль, знак возвращаем в конце
+    bool negative = digits[CHUNKS - 1] < 0;
+    if (negative) {
+        for (int i = 0; i < CHUNKS; i++) {
+            digits[i] = -digits[i];
+        }
+        normalize(digits);
+    }
+
+    int top = CHUNKS - 1;
+    while (top >= 0 && digits[top] == 0) {
+        top--;
+    }
+    if (top < 0) {
+        return 0.0;
+    }
+
+    // Старшие три цифры: не меньше 65 значащих бит - хватает на 53 бита,
+    // бит округления и часть "липкого" остатка; остальное - младшие цифры
+    auto digitAt = [&digits](int index) -> uint64_t {
+        return index >= 0 ? static_cast<uint64_t>(digits[index]) : 0;
+    };
+    uint128_t window = (static_cast<uint128_t>(digitAt(top)) << 64) |
+                               (static_cast<uint128_t>(digitAt(top - 1)) << 32) |
+                               digitAt(top - 2);
+    bool sticky = false;
+    for (int i = 0; i < top - 2; i++) {
+        sticky = sticky || digits[i] != 0;
+    }
+
+    int drop = bitLength(window) - (MANTISSA_BITS + 1);
+    uint64_t mantissa = static_cast<uint64_t>(window >> drop);
+    uint128_t rest = window & ((static_cast<uint128_t>(1) << drop) - 1);
+    uint128_t half = static_cast<uint128_t>(1) << (drop - 1);
+    if (rest > half || (rest == half && (sticky || (mantissa & 1)))) {
+        mantissa++;
+    }
+
+    // Сумма меньше 2^53 единиц 2^-1074 уже целая в этих единицах и
+    // представима точно (в том числе субнормальной); иначе округлена выше.
+    // Переполнение дает inf, как при округлении к ближайшему
+    int exponent = (top - 2) * CHUNK_BITS + drop - 1074;
+    double result = std::ldexp(static_cast<double>(mantissa), exponent);
+    return negative ? -result : result;
+}
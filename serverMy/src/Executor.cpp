@@ -0,0 +1,254 @@
+#include "Executor.h"
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <cerrno>
+
+namespace {
+    thread_local Executor::Worker* currentWorker = nullptr;
+
+    const int EPOLL_BATCH = 64;
+
+    // Корутина верхнего уровня: владеет задачей сессии,
+    // кадр освобождается сам по завершении (final_suspend не приостанавливает)
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() {
+                return Detached{std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+            std::suspend_never final_suspend() const noexcept { return {}; }
+            void return_void() {}
+            // Ошибки сессии обрабатываются внутри нее; сюда доходит только нарушение логики
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    Detached launch(Task<void> task) {
+        co_await task;
+    }
+}
+
+Executor::Worker::Worker() : index(0), epollFd(-1), wakeFd(-1), stopping(false) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd >= 0 && wakeFd >= 0) {
+        // data.ptr == nullptr - пробуждение через eventfd
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    }
+}
+
+Executor::Worker::~Worker() {
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+    if (wakeFd >= 0) {
+        close(wakeFd);
+    }
+}
+
+bool Executor::Worker::watch(Waiter& waiter, uint32_t events, bool& registered, int timeoutMs) {
+    struct epoll_event event;
+    event.events = events | EPOLLONESHOT;
+    event.data.ptr = &waiter;
+    if (epoll_ctl(epollFd, registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, waiter.fd, &event) != 0) {
+        return false;
+    }
+    registered = true;
+
+    waiter.events = 0;
+    waiter.registered = &registered;
+    waiter.timed = timeoutMs >= 0;
+    if (waiter.timed) {
+        waiter.timer = timers.emplace(Clock::now() + std::chrono::milliseconds(timeoutMs), &waiter);
+    }
+    return true;
+}
+
+void Executor::Worker::sleep(Waiter& waiter, int timeoutMs) {
+    waiter.fd = -1;
+    waiter.events = 0;
+    waiter.registered = nullptr;
+    waiter.timed = true;
+    waiter.timer = timers.emplace(Clock::now() + std::chrono::milliseconds(timeoutMs), &waiter);
+}
+
+void Executor::Worker::forget(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void Executor::Worker::post(std::coroutine_handle<> handle) {
+    {
+        std::lock_guard<std::mutex> lock(incomingMutex);
+        incoming.push_back(handle);
+    }
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+int Executor::Worker::nextTimeoutMs() const {
+    if (timers.empty()) {
+        return -1;
+    }
+    auto left = timers.begin()->first - Clock::now();
+    if (left <= Clock::duration::zero()) {
+        return 0;
+    }
+    // С округлением вверх: иначе epoll_wait вернется раньше срока вхолостую
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(left).count());
+}
+
+void Executor::Worker::expireTimers() {
+    auto now = Clock::now();
+    while (!timers.empty() && timers.begin()->first <= now) {
+        Waiter* waiter = timers.begin()->second;
+        timers.erase(timers.begin());
+        waiter->timed = false;
+        waiter->events = 0;
+
+        // Убрать fd из epoll: событие после возобновления указывало бы на чужой
+        // кадр, а EPOLLHUP/EPOLLERR приходят и при пустой маске. Следующее
+        // ожидание добавит fd заново
+        if (waiter->fd >= 0) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, waiter->fd, nullptr);
+            *waiter->registered = false;
+        }
+        waiter->handle.resume();
+    }
+}
+
+void Executor::Worker::run() {
+    currentWorker = this;
+    struct epoll_event events[EPOLL_BATCH];
+    std::vector<std::coroutine_handle<>> started;
+
+    while (!stopping) {
+        {
+            std::lock_guard<std::mutex> lock(incomingMutex);
+            started.swap(incoming);
+        }
+        for (std::coroutine_handle<> handle : started) {
+            handle.resume();
+        }
+        started.clear();
+
+        // Пока в очереди планировщика есть готовые ходы, epoll только опрашивается
+        int timeoutMs = nextTimeoutMs();
+        int idleMs = scheduler.idleTimeoutMs();
+        if (idleMs >= 0 && (timeoutMs < 0 || idleMs < timeoutMs)) {
+            timeoutMs = idleMs;
+        }
+
+        int count = epoll_wait(epollFd, events, EPOLL_BATCH, timeoutMs);
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            Waiter* waiter = static_cast<Waiter*>(events[i].data.ptr);
+            if (waiter == nullptr) {
+                uint64_t value;
+                ssize_t received = read(wakeFd, &value, sizeof(value));
+                (void)received;
+                continue;
+            }
+            if (waiter->timed) {
+                timers.erase(waiter->timer);
+                waiter->timed = false;
+            }
+            waiter->events = events[i].events;
+            waiter->handle.resume();
+        }
+
+        expireTimers();
+        scheduler.dispatch();
+    }
+
+    currentWorker = nullptr;
+}
+
+bool Executor::SleepAwaiter::await_ready() {
+    worker = Executor::current();
+    if (worker == nullptr) {
+        if (timeoutMs > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        }
+        return true;
+    }
+    return timeoutMs <= 0;
+}
+
+void Executor::SleepAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    waiter.handle = handle;
+    worker->sleep(waiter, timeoutMs);
+}
+
+Executor::Executor(size_t threads) : started(false) {
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back(new Worker());
+        workers.back()->index = i;
+    }
+}
+
+Executor::~Executor() {
+    stop();
+}
+
+bool Executor::start(const std::function<void(size_t)>& onStart) {
+    for (const auto& worker : workers) {
+        if (worker->epollFd < 0 || worker->wakeFd < 0) {
+            return false;
+        }
+    }
+
+    for (const auto& worker : workers) {
+        Worker* raw = worker.get();
+        raw->thread = std::thread([raw, onStart] {
+            if (onStart) {
+                onStart(raw->index);
+            }
+            raw->run();
+        });
+    }
+    started = true;
+    return true;
+}
+
+void Executor::spawn(size_t worker, Task<void> task) {
+    workers[worker % workers.size()]->post(launch(std::move(task)).handle);
+}
+
+void Executor::stop() {
+    if (!started) {
+        return;
+    }
+    for (const auto& worker : workers) {
+        worker->stopping = true;
+        uint64_t one = 1;
+        ssize_t written = write(worker->wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+    for (const auto& worker : workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    started = false;
+}
+
+Executor::Worker* Executor::current() {
+    return currentWorker;
+}
+
+Executor::SleepAwaiter Executor::sleep(int timeoutMs) {
+    SleepAwaiter awaiter;
+    awaiter.timeoutMs = timeoutMs;
+    awaiter.worker = nullptr;
+    return awaiter;
+}
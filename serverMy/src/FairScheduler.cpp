@@ -0,0 +1,276 @@
+#include "FairScheduler.h"
+#include "Executor.h"
+#include "Config.h"
+#include <mutex>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+
+// Бюджет CPU логина - общий для всех потоков исполнителя
+struct FairScheduler::Account {
+    std::mutex mutex;
+    int64_t budgetNs;       // на окно; 0 - без ограничения
+    int64_t windowStartNs;
+    int64_t usedNs;
+
+    // Бюджет окна исчерпан; refillNs - когда начнется следующее окно
+    bool exhausted(int64_t now, int64_t& refillNs) {
+        std::lock_guard<std::mutex> lock(mutex);
+        roll(now);
+        refillNs = windowStartNs + WINDOW_NS;
+        return budgetNs > 0 && usedNs >= budgetNs;
+    }
+
+    void charge(int64_t costNs, int64_t now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        roll(now);
+        usedNs += costNs;
+    }
+
+    // Счет читают потоки других исполнителей - бюджет меняется под его мьютексом
+    void setBudget(int64_t value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        budgetNs = value;
+    }
+
+private:
+    static const int64_t WINDOW_NS = static_cast<int64_t>(Config::SCHED_BUDGET_WINDOW_MS) * 1000000;
+
+    void roll(int64_t now) {
+        if (now - windowStartNs >= WINDOW_NS) {
+            windowStartNs = now;
+            usedNs = 0;
+        }
+    }
+};
+
+namespace {
+    const int64_t QUANTUM_NS = static_cast<int64_t>(Config::SCHED_QUANTUM_US) * 1000;
+    const int64_t DISPATCH_SLICE_NS = static_cast<int64_t>(Config::SCHED_DISPATCH_SLICE_US) * 1000;
+
+    // Счета логинов: живут, пока у логина есть сессии хотя бы в одном потоке
+    std::mutex accountsMutex;
+    std::unordered_map<std::string, std::weak_ptr<FairScheduler::Account>> accounts;
+
+    int64_t monotonicNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Время CPU потока: ожидание сокетов и вытеснение ядром в стоимость хода не входят
+    int64_t threadCpuNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    std::shared_ptr<FairScheduler::Account> obtainAccount(const std::string& login, uint32_t cpuMsPerSec) {
+        std::shared_ptr<FairScheduler::Account> account;
+        {
+            std::lock_guard<std::mutex> lock(accountsMutex);
+            account = accounts[login].lock();
+            if (!account) {
+                account = std::make_shared<FairScheduler::Account>();
+                account->budgetNs = 0;
+                account->windowStartNs = monotonicNs();
+                account->usedNs = 0;
+                accounts[login] = account;
+            }
+        }
+        // Бюджет в мс за секунду -> нс за окно; берется из последнего профиля логина
+        account->setBudget(static_cast<int64_t>(cpuMsPerSec) * Config::SCHED_BUDGET_WINDOW_MS * 1000);
+        return account;
+    }
+}
+
+FairScheduler::FairScheduler() {}
+
+FairScheduler::~FairScheduler() {
+    std::lock_guard<std::mutex> lock(accountsMutex);
+    for (auto& entry : flows) {
+        auto it = accounts.find(entry.first);
+        entry.second->account.reset();
+        if (it != accounts.end() && it->second.expired()) {
+            accounts.erase(it);
+        }
+    }
+}
+
+FairScheduler::Flow* FairScheduler::attach(const std::string& login, const QosProfile& profile) {
+    std::unique_ptr<Flow>& slot = flows[login];
+    if (!slot) {
+        slot.reset(new Flow());
+        slot->owner = this;
+        slot->login = login;
+        slot->deficitNs = 0;
+        slot->sessions = 0;
+        slot->active = false;
+        slot->running = false;
+    }
+    slot->profile = profile;
+    slot->account = obtainAccount(login, profile.cpuMsPerSec);
+    slot->sessions++;
+    return slot.get();
+}
+
+void FairScheduler::detach(Flow* flow) {
+    if (flow == nullptr) {
+        return;
+    }
+    flow->sessions--;
+    release(flow);
+}
+
+void FairScheduler::release(Flow* flow) {
+    // Пока поток в списке класса или возобновлен из dispatch, его удалит dispatch
+    if (flow->sessions > 0 || flow->active || flow->running) {
+        return;
+    }
+
+    std::string login = flow->login;
+    flow->account.reset();
+    flows.erase(login);
+
+    std::lock_guard<std::mutex> lock(accountsMutex);
+    auto it = accounts.find(login);
+    if (it != accounts.end() && it->second.expired()) {
+        accounts.erase(it);
+    }
+}
+
+FairScheduler::TurnAwaiter FairScheduler::turn(Flow* flow) {
+    return TurnAwaiter{flow};
+}
+
+FairScheduler* FairScheduler::current() {
+    Executor::Worker* worker = Executor::current();
+    return worker != nullptr ? &worker->getScheduler() : nullptr;
+}
+
+bool FairScheduler::TurnAwaiter::await_ready() const {
+    // Бенчмарки и отказ в приеме выполняются без исполнителя - очереди нет
+    return flow == nullptr || Executor::current() == nullptr;
+}
+
+void FairScheduler::TurnAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    flow->waiting.push_back(handle);
+    flow->owner->activate(flow);
+}
+
+void FairScheduler::activate(Flow* flow) {
+    if (!flow->active) {
+        flow->active = true;
+        active[static_cast<int>(flow->profile.qos)].push_back(flow);
+    }
+}
+
+bool FairScheduler::serveClass(int qos, int64_t now) {
+    std::deque<Flow*>& list = active[qos];
+
+    // Каждый поток класса - не больше одного визита: исчерпавшие бюджет
+    // уходят в конец и ждут следующего окна
+    for (size_t visits = list.size(); visits > 0; visits--) {
+        Flow* flow = list.front();
+        list.pop_front();
+
+        int64_t refillNs = 0;
+        if (flow->account->exhausted(now, refillNs)) {
+            list.push_back(flow);
+            continue;
+        }
+
+        // Квант пропорционален весу; перерасход прошлого визита уменьшает этот
+        flow->deficitNs += QUANTUM_NS * flow->profile.weight;
+        while (flow->deficitNs > 0 && !flow->waiting.empty()) {
+            std::coroutine_handle<> handle = flow->waiting.front();
+            flow->waiting.pop_front();
+
+            // Сессия выполняется до следующего turn или ожидания сокета
+            flow->running = true;
+            int64_t cpuStart = threadCpuNs();
+            handle.resume();
+            int64_t costNs = threadCpuNs() - cpuStart;
+            flow->running = false;
+
+            flow->deficitNs -= costNs;
+            flow->account->charge(costNs, monotonicNs());
+            if (flow->account->exhausted(monotonicNs(), refillNs)) {
+                break;
+            }
+        }
+
+        if (flow->waiting.empty()) {
+            // Неиспользованный дефицит не копится: иначе простаивавший логин
+            // потом надолго захватил бы поток
+            flow->deficitNs = 0;
+            flow->active = false;
+            release(flow);
+        } else {
+            list.push_back(flow);
+        }
+        return true;
+    }
+    return false;
+}
+
+void FairScheduler::dispatch() {
+    int64_t started = monotonicNs();
+    int64_t now = started;
+
+    // Строгий приоритет классов: после каждого визита выбор начинается
+    // заново с высшего класса - ход интерактивной сессии не ждет очереди bulk
+    while (now - started < DISPATCH_SLICE_NS) {
+        bool served = false;
+        for (int qos = 0; qos < CLASS_COUNT && !served; qos++) {
+            served = serveClass(qos, now);
+        }
+        if (!served) {
+            break;
+        }
+        now = monotonicNs();
+    }
+}
+
+int FairScheduler::idleTimeoutMs() const {
+    int64_t now = monotonicNs();
+    int64_t earliestRefill = -1;
+
+    for (int qos = 0; qos < CLASS_COUNT; qos++) {
+        for (Flow* flow : active[qos]) {
+            int64_t refillNs = 0;
+            if (!flow->waiting.empty() && !flow->account->exhausted(now, refillNs)) {
+                return 0;
+            }
+            if (earliestRefill < 0 || refillNs < earliestRefill) {
+                earliestRefill = refillNs;
+            }
+        }
+    }
+
+    if (earliestRefill < 0) {
+        return -1;
+    }
+    // С округлением вверх, как у таймеров исполнителя
+    return static_cast<int>((std::max<int64_t>(earliestRefill - now, 0) + 999999) / 1000000);
+}
+
+bool FairScheduler::parseClass(const std::string& name, QosClass& qos) {
+    if (name == "interactive") {
+        qos = QosClass::INTERACTIVE;
+    } else if (name == "standard") {
+        qos = QosClass::STANDARD;
+    } else if (name == "bulk") {
+        qos = QosClass::BULK;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* FairScheduler::className(QosClass qos) {
+    switch (qos) {
+        case QosClass::INTERACTIVE: return "interactive";
+        case QosClass::BULK: return "bulk";
+        default: return "standard";
+    }
+}
@@ -0,0 +1,209 @@
+#include "FlightRecorder.h"
+#include "Config.h"
+#include <mutex>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+std::atomic<bool> FlightRecorder::enabled(true);
+
+namespace {
+    static_assert((Config::TRACE_RING_EVENTS & (Config::TRACE_RING_EVENTS - 1)) == 0,
+                  "TRACE_RING_EVENTS должно быть степенью двойки");
+
+    // Слот - seqlock: пока последовательность нечетная, слот перезаписывается
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        std::atomic<uint32_t> thread;
+        std::atomic<uint8_t> stage;
+        std::atomic<uint64_t> startNs;
+        std::atomic<uint64_t> durationNs;
+        std::atomic<uint64_t> session;
+        std::atomic<uint64_t> arg;
+    };
+
+    // Кольцо пишет только поток-владелец; head - число записанных событий
+    struct Ring {
+        std::atomic<uint64_t> head;
+        Slot slots[Config::TRACE_RING_EVENTS];
+    };
+
+    // Кольца не освобождаются: дамп видит и события завершившихся потоков,
+    // а их кольца достаются новым потокам
+    std::mutex ringsMutex;
+    std::vector<Ring*> rings;
+    std::vector<Ring*> freeRings;
+    std::atomic<uint64_t> nextSession(1);
+
+    struct RingOwner {
+        Ring* ring = nullptr;
+        uint32_t thread = 0;
+
+        ~RingOwner() {
+            if (ring != nullptr) {
+                std::lock_guard<std::mutex> lock(ringsMutex);
+                freeRings.push_back(ring);
+            }
+        }
+    };
+
+    thread_local RingOwner owner;
+
+    RingOwner& threadRing() {
+        if (owner.ring == nullptr) {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            if (!freeRings.empty()) {
+                owner.ring = freeRings.back();
+                freeRings.pop_back();
+            } else {
+                owner.ring = new Ring();
+                rings.push_back(owner.ring);
+            }
+            owner.thread = static_cast<uint32_t>(gettid());
+        }
+        return owner;
+    }
+
+    void writeMicros(std::ostream& out, uint64_t ns) {
+        out << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000 << std::setfill(' ');
+    }
+}
+
+void FlightRecorder::record(TraceStage stage, uint64_t session, uint64_t startNs,
+                            uint64_t durationNs, uint64_t arg) {
+    RingOwner& local = threadRing();
+    Ring& ring = *local.ring;
+    uint64_t index = ring.head.load(std::memory_order_relaxed);
+    Slot& slot = ring.slots[index & (Config::TRACE_RING_EVENTS - 1)];
+
+    uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.thread.store(local.thread, std::memory_order_relaxed);
+    slot.stage.store(static_cast<uint8_t>(stage), std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.durationNs.store(durationNs, std::memory_order_relaxed);
+    slot.session.store(session, std::memory_order_relaxed);
+    slot.arg.store(arg, std::memory_order_relaxed);
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    ring.head.store(index + 1, std::memory_order_release);
+}
+
+uint64_t FlightRecorder::newSession() {
+    return nextSession.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FlightRecorder::setEnabled(bool value) {
+    enabled.store(value, std::memory_order_relaxed);
+}
+
+std::vector<TraceEvent> FlightRecorder::snapshot() {
+    std::vector<Ring*> current;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        current = rings;
+    }
+
+    std::vector<TraceEvent> events;
+    for (Ring* ring : current) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t first = head > Config::TRACE_RING_EVENTS ? head - Config::TRACE_RING_EVENTS : 0;
+
+        for (uint64_t index = first; index < head; index++) {
+            const Slot& slot = ring->slots[index & (Config::TRACE_RING_EVENTS - 1)];
+            uint32_t before = slot.sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+
+            TraceEvent event;
+            event.thread = slot.thread.load(std::memory_order_relaxed);
+            event.stage = static_cast<TraceStage>(slot.stage.load(std::memory_order_relaxed));
+            event.startNs = slot.startNs.load(std::memory_order_relaxed);
+            event.durationNs = slot.durationNs.load(std::memory_order_relaxed);
+            event.session = slot.session.load(std::memory_order_relaxed);
+            event.arg = slot.arg.load(std::memory_order_relaxed);
+
+            // Владелец успел перезаписать слот, пока мы его читали
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != before) {
+                continue;
+            }
+            events.push_back(event);
+        }
+    }
+
+    std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) {
+        return a.startNs < b.startNs;
+    });
+    return events;
+}
+
+long FlightRecorder::dump(const std::string& path) {
+    std::vector<TraceEvent> events = snapshot();
+    long pid = static_cast<long>(getpid());
+
+    // Событие "X" - этап с длительностью; tid - номер сессии,
+    // поэтому этапы одной сессии вкладываются друг в друга
+    std::ostringstream json;
+    json << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent& event = events[i];
+        json << (i == 0 ? "\n" : ",\n")
+             << "{\"name\":\"" << stageName(event.stage) << "\",\"cat\":\"vcalc\",\"ph\":\"X\""
+             << ",\"pid\":" << pid << ",\"tid\":" << event.session << ",\"ts\":";
+        writeMicros(json, event.startNs);
+        json << ",\"dur\":";
+        writeMicros(json, event.durationNs);
+        json << ",\"args\":{\"thread\":" << event.thread << ",\"arg\":" << event.arg << "}}";
+    }
+    json << "\n]}\n";
+    std::string text = json.str();
+
+    // Временный файл - новый, с уникальным именем (mkstemp: O_EXCL, 0600):
+    // подложенная заранее символическая ссылка не перенаправит запись,
+    // а rename заменяет саму ссылку на месте path, а не ее цель
+    std::string tempPath = path + ".XXXXXX";
+    int fd = mkstemp(&tempPath[0]);
+    if (fd < 0) {
+        return -1;
+    }
+    const char* ptr = text.data();
+    size_t left = text.size();
+    while (left > 0) {
+        ssize_t written = write(fd, ptr, left);
+        if (written <= 0) {
+            break;
+        }
+        ptr += written;
+        left -= written;
+    }
+
+    if (close(fd) != 0 || left > 0 || rename(tempPath.c_str(), path.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        return -1;
+    }
+    return static_cast<long>(events.size());
+}
+
+const char* FlightRecorder::stageName(TraceStage stage) {
+    switch (stage) {
+        case TraceStage::ACCEPT: return "accept";
+        case TraceStage::SESSION: return "session";
+        case TraceStage::TLS_HANDSHAKE: return "tls_handshake";
+        case TraceStage::AUTH: return "auth";
+        case TraceStage::RECEIVE_LOGIN: return "receive_login";
+        case TraceStage::RECEIVE_HASH: return "receive_hash";
+        case TraceStage::VERIFY_HASH: return "verify_hash";
+        case TraceStage::SCHEDULER_WAIT: return "scheduler_wait";
+        case TraceStage::FLUSH: return "flush";
+        case TraceStage::RECEIVE_VECTOR: return "receive_vector";
+        case TraceStage::COMPUTE: return "compute";
+        default: return "unknown";
+    }
+}
@@ -66,3 +66,10 @@ void Logger::log(LogLevel level, const std::string& message, const std::string&
 void Logger::logError(bool isCritical, const std::string& message, const std::string& params) {
     log(isCritical ? LogLevel::CRITICAL : LogLevel::ERROR, message, params);
 }
+
+void Logger::flush() {
+    std::lock_guard<std::mutex> lock(logMutex);
+    if (logFile.is_open()) {
+        logFile.flush();
+    }
+}
@@ -0,0 +1,221 @@
+#include "NumaPlacement.h"
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+
+#ifdef VCALC_WITH_NUMA
+#include <numa.h>
+#endif
+
+namespace {
+    const char NODE_ROOT[] = "/sys/devices/system/node/";
+
+    struct Topology {
+        std::vector<std::vector<int>> nodes;  // CPU каждого узла
+        std::vector<int> cpuNode;             // узел каждого CPU
+    };
+
+    std::string readLine(const std::string& path) {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+    Topology loadTopology() {
+        Topology topology;
+        std::vector<int> nodeIds;
+
+        // Без sysfs (контейнер, не-NUMA ядро) считаем машину одним узлом
+        if (!NumaPlacement::parseCpuList(readLine(std::string(NODE_ROOT) + "online"), nodeIds) ||
+            nodeIds.empty()) {
+            nodeIds.assign(1, 0);
+        }
+
+        int maxNode = *std::max_element(nodeIds.begin(), nodeIds.end());
+        topology.nodes.resize(maxNode + 1);
+        for (int node : nodeIds) {
+            std::string path = std::string(NODE_ROOT) + "node" + std::to_string(node) + "/cpulist";
+            NumaPlacement::parseCpuList(readLine(path), topology.nodes[node]);
+        }
+
+        if (nodeIds.size() == 1 && topology.nodes[nodeIds[0]].empty()) {
+            long count = sysconf(_SC_NPROCESSORS_ONLN);
+            for (long cpu = 0; cpu < count; cpu++) {
+                topology.nodes[nodeIds[0]].push_back(static_cast<int>(cpu));
+            }
+        }
+
+        for (size_t node = 0; node < topology.nodes.size(); node++) {
+            for (int cpu : topology.nodes[node]) {
+                if (cpu >= static_cast<int>(topology.cpuNode.size())) {
+                    topology.cpuNode.resize(cpu + 1, -1);
+                }
+                topology.cpuNode[cpu] = static_cast<int>(node);
+            }
+        }
+        return topology;
+    }
+
+    const Topology& topology() {
+        static const Topology instance = loadTopology();
+        return instance;
+    }
+
+    // Размещение страниц без libnuma: их первым касается поток на CPU узла
+    void touchPages(void* memory, size_t bytes) {
+        long pageSize = sysconf(_SC_PAGESIZE);
+        volatile char* bytesPtr = static_cast<volatile char*>(memory);
+        for (size_t offset = 0; offset < bytes; offset += pageSize) {
+            bytesPtr[offset] = 0;
+        }
+    }
+}
+
+bool NumaPlacement::parseCpuList(const std::string& text, std::vector<int>& cpus) {
+    cpus.clear();
+    std::stringstream stream(text);
+    std::string range;
+
+    while (std::getline(stream, range, ',')) {
+        if (range.empty()) {
+            continue;
+        }
+
+        size_t dash = range.find('-');
+        try {
+            size_t used = 0;
+            int first = std::stoi(range, &used);
+            int last = first;
+            if (dash != std::string::npos) {
+                last = std::stoi(range.substr(dash + 1));
+            } else if (used != range.size()) {
+                return false;
+            }
+            if (first < 0 || last < first) {
+                return false;
+            }
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return true;
+}
+
+bool NumaPlacement::libnumaAvailable() {
+#ifdef VCALC_WITH_NUMA
+    return numa_available() >= 0;
+#else
+    return false;
+#endif
+}
+
+int NumaPlacement::nodeCount() {
+    return static_cast<int>(topology().nodes.size());
+}
+
+const std::vector<int>& NumaPlacement::nodeCpus(int node) {
+    static const std::vector<int> none;
+    if (node < 0 || node >= nodeCount()) {
+        return none;
+    }
+    return topology().nodes[node];
+}
+
+int NumaPlacement::nodeOfCpu(int cpu) {
+    const std::vector<int>& cpuNode = topology().cpuNode;
+    if (cpu < 0 || cpu >= static_cast<int>(cpuNode.size())) {
+        return -1;
+    }
+    return cpuNode[cpu];
+}
+
+std::vector<int> NumaPlacement::onlineCpus() {
+    std::vector<int> cpus;
+    for (const std::vector<int>& node : topology().nodes) {
+        cpus.insert(cpus.end(), node.begin(), node.end());
+    }
+    std::sort(cpus.begin(), cpus.end());
+    return cpus;
+}
+
+bool NumaPlacement::pinThread(const std::vector<int>& cpus) {
+    if (cpus.empty()) {
+        return false;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+bool NumaPlacement::bindThreadToNode(int node, const std::vector<int>& allowed) {
+    std::vector<int> cpus;
+    for (int cpu : nodeCpus(node)) {
+        if (allowed.empty() || std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+            cpus.push_back(cpu);
+        }
+    }
+    if (!pinThread(cpus)) {
+        return false;
+    }
+
+#ifdef VCALC_WITH_NUMA
+    // Новые страницы потока - на узле, где он выполняется
+    if (libnumaAvailable()) {
+        numa_set_localalloc();
+    }
+#endif
+    return true;
+}
+
+void* NumaPlacement::allocateOnNode(size_t bytes, int node) {
+#ifdef VCALC_WITH_NUMA
+    if (libnumaAvailable()) {
+        return numa_alloc_onnode(bytes, node);
+    }
+#endif
+
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+
+    std::thread toucher([memory, bytes, node] {
+        bindThreadToNode(node, std::vector<int>());
+        touchPages(memory, bytes);
+    });
+    toucher.join();
+    return memory;
+}
+
+void NumaPlacement::freeOnNode(void* memory, size_t bytes) {
+    if (memory == nullptr) {
+        return;
+    }
+
+#ifdef VCALC_WITH_NUMA
+    if (libnumaAvailable()) {
+        numa_free(memory, bytes);
+        return;
+    }
+#endif
+
+    munmap(memory, bytes);
+}
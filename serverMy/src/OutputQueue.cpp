@@ -0,0 +1,193 @@
+#include "OutputQueue.h"
+#include "Config.h"
+#include "AsyncSocket.h"
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <climits>
+#include <cstring>
+#include <cerrno>
+
+OutputQueue::OutputQueue(AsyncSocket& socket)
+    : socket(socket), pending(0), bulk(false), corked(false) {}
+
+bool OutputQueue::enqueue(const void* data, size_t length) {
+    if (length == 0) {
+        return true;
+    }
+
+    size_t offset = storage.size();
+    storage.resize(offset + length);
+    memcpy(storage.data() + offset, data, length);
+
+    // Соседние копии склеиваем в один сегмент - меньше iovec при отправке
+    if (!segments.empty() && segments.back().external == nullptr &&
+        segments.back().offset + segments.back().length == offset) {
+        segments.back().length += length;
+    } else {
+        segments.push_back({nullptr, offset, length});
+    }
+    pending += length;
+
+    if (pending >= static_cast<size_t>(Config::OUTPUT_QUEUE_LIMIT)) {
+        bool blocked = false;
+        return writeAvailable(blocked);
+    }
+    return true;
+}
+
+bool OutputQueue::enqueueRef(const void* data, size_t length) {
+    if (length == 0) {
+        return true;
+    }
+
+    segments.push_back({static_cast<const uint8_t*>(data), 0, length});
+    pending += length;
+
+    if (pending >= static_cast<size_t>(Config::OUTPUT_QUEUE_LIMIT)) {
+        bool blocked = false;
+        return writeAvailable(blocked);
+    }
+    return true;
+}
+
+bool OutputQueue::congested() const {
+    return pending >= static_cast<size_t>(Config::OUTPUT_QUEUE_LIMIT);
+}
+
+bool OutputQueue::writeAvailable(bool& blocked) {
+    blocked = false;
+
+    // В режиме потока промежуточные сбросы идут под пробкой,
+    // чтобы ядро отправляло только полные сегменты
+    if (bulk && !corked) {
+        setCork(true);
+    }
+
+    size_t first = 0;
+    size_t skip = 0;  // уже отправленные байты сегмента first
+
+    while (first < segments.size()) {
+        struct iovec iov[IOV_MAX];
+        int iovCount = 0;
+
+        for (size_t i = first; i < segments.size() && iovCount < IOV_MAX; i++) {
+            const Segment& seg = segments[i];
+            const uint8_t* base = seg.external ? seg.external : storage.data() + seg.offset;
+            size_t shift = (i == first) ? skip : 0;
+            iov[iovCount].iov_base = const_cast<uint8_t*>(base + shift);
+            iov[iovCount].iov_len = seg.length - shift;
+            iovCount++;
+        }
+
+        ssize_t sent = socket.writeSome(iov, iovCount);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Отправленное убираем из очереди, остаток ждет готовности сокета
+            segments.erase(segments.begin(), segments.begin() + first);
+            if (skip > 0) {
+                Segment& seg = segments.front();
+                if (seg.external) {
+                    seg.external += skip;
+                } else {
+                    seg.offset += skip;
+                }
+                seg.length -= skip;
+            }
+            pending = 0;
+            for (const Segment& seg : segments) {
+                pending += seg.length;
+            }
+            blocked = true;
+            return true;
+        }
+        if (sent <= 0) {
+            segments.clear();
+            storage.clear();
+            pending = 0;
+            return false;
+        }
+
+        // Продвигаемся по сегментам на число отправленных байт
+        size_t left = static_cast<size_t>(sent);
+        while (left > 0) {
+            size_t rest = segments[first].length - skip;
+            if (left >= rest) {
+                left -= rest;
+                first++;
+                skip = 0;
+            } else {
+                skip += left;
+                left = 0;
+            }
+        }
+    }
+
+    segments.clear();
+    storage.clear();
+    pending = 0;
+    return true;
+}
+
+Task<bool> OutputQueue::drain() {
+    while (pending > 0) {
+        bool blocked = false;
+        if (!writeAvailable(blocked)) {
+            co_return false;
+        }
+        if (blocked) {
+            bool ready = co_await socket.wait(socket.writeWaitEvents(), -1);
+            if (!ready) {
+                co_return false;
+            }
+        }
+    }
+    co_return true;
+}
+
+Task<bool> OutputQueue::flush() {
+    bool drained = co_await drain();
+    if (!drained) {
+        co_return false;
+    }
+
+    // Снятие пробки выталкивает неполный последний сегмент
+    if (corked) {
+        setCork(false);
+    }
+    co_return true;
+}
+
+Task<bool> OutputQueue::sendNow(const void* data, size_t length) {
+    if (!enqueue(data, length)) {
+        co_return false;
+    }
+    co_return co_await flush();
+}
+
+void OutputQueue::beginBulk() {
+    bulk = true;
+}
+
+Task<bool> OutputQueue::endBulk() {
+    bulk = false;
+    co_return co_await flush();
+}
+
+bool OutputQueue::setNoDelay(bool enable) {
+    int opt = enable ? 1 : 0;
+    return setsockopt(socket.get(), IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt)) == 0;
+}
+
+bool OutputQueue::setCork(bool enable) {
+    int opt = enable ? 1 : 0;
+    // Для не-TCP сокетов опция недоступна - это не ошибка
+    if (setsockopt(socket.get(), IPPROTO_TCP, TCP_CORK, &opt, sizeof(opt)) != 0) {
+        return false;
+    }
+    corked = enable;
+    return true;
+}
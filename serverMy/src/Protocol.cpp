@@ -1,45 +1,52 @@
 #include "Protocol.h"
 #include "Config.h"
+#include "OutputQueue.h"
+#include "AsyncSocket.h"
+#include "VectorProcessor.h"
+#include "Compression.h"
+#include "AdmissionController.h"
+#include "ResultCache.h"
+#include "VectorStore.h"
+#include "RangeSums.h"
+#include "SharedRegion.h"
+#include "FlightRecorder.h"
+#include "Logger.h"
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/ioctl.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <cstring>
 #include <iomanip>
 #include <sstream>
-#include <iostream>
 #include <algorithm>  // Добавлено для std::transform
 #include <cctype>     // Добавлено для ::toupper
 
-bool Protocol::sendSalt(int clientSocket, const std::string& salt) {
+Task<bool> Protocol::sendSalt(OutputQueue& out, const std::string& salt) {
     if (salt.length() != Config::SALT_HEX_LENGTH) {
-        return false;
+        co_return false;
     }
     
-    return sendAll(clientSocket, salt.c_str(), salt.length());
+    // Клиент ждет соль, прежде чем что-то отправить - уходит сразу
+    co_return co_await out.sendNow(salt.c_str(), salt.length());
 }
 
-bool Protocol::sendError(int clientSocket) {
-    return sendAll(clientSocket, Config::ERR_MSG.c_str(), Config::ERR_MSG.length());
+Task<bool> Protocol::sendError(OutputQueue& out) {
+    co_return co_await out.sendNow(Config::ERR_MSG.c_str(), Config::ERR_MSG.length());
 }
 
-bool Protocol::sendOk(int clientSocket) {
-    return sendAll(clientSocket, Config::OK_MSG.c_str(), Config::OK_MSG.length());
+Task<bool> Protocol::sendOk(OutputQueue& out) {
+    co_return co_await out.sendNow(Config::OK_MSG.c_str(), Config::OK_MSG.length());
 }
 
-bool Protocol::receiveLogin(int clientSocket, std::string& login) {
+Task<bool> Protocol::receiveLogin(AsyncSocket& clientSocket, std::string& login) {
     char buffer[256] = {0};
     
     // Читаем логин с таймаутом
-    struct timeval tv;
-    tv.tv_sec = 5;
-    tv.tv_usec = 0;
-    setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-    
-    ssize_t received = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
+    ssize_t received = co_await clientSocket.receiveSome(buffer, sizeof(buffer) - 1, AUTH_TIMEOUT_MS);
     
     if (received <= 0) {
-        return false;
+        co_return false;
     }
     
     // Преобразуем в строку и обрезаем символы новой строки
@@ -55,21 +62,16 @@ bool Protocol::receiveLogin(int clientSocket, std::string& login) {
     login.erase(0, login.find_first_not_of(" \t"));
     login.erase(login.find_last_not_of(" \t") + 1);
     
-    return !login.empty();
+    co_return !login.empty();
 }
 
-bool Protocol::receiveHash(int clientSocket, std::string& hash) {
+Task<bool> Protocol::receiveHash(AsyncSocket& clientSocket, std::string& hash) {
     char buffer[256] = {0};
     
-    struct timeval tv;
-    tv.tv_sec = 5;
-    tv.tv_usec = 0;
-    setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-    
-    ssize_t received = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
+    ssize_t received = co_await clientSocket.receiveSome(buffer, sizeof(buffer) - 1, AUTH_TIMEOUT_MS);
     
     if (received <= 0) {
-        return false;
+        co_return false;
     }
     
     hash = std::string(buffer, received);
@@ -83,7 +85,7 @@ bool Protocol::receiveHash(int clientSocket, std::string& hash) {
     hash.erase(0, hash.find_first_not_of(" \t"));
     hash.erase(hash.find_last_not_of(" \t") + 1);
     
-    return !hash.empty();
+    co_return !hash.empty();
 }
 
 bool Protocol::sendVectorResults(int clientSocket, const std::vector<double>& results) {
@@ -92,78 +94,748 @@ bool Protocol::sendVectorResults(int clientSocket, const std::vector<double>& re
     return true;
 }
 
-bool Protocol::receiveVectorData(int clientSocket, std::vector<uint8_t>& binaryData) {
-    // Убираем таймаут совсем
-    struct timeval tv;
-    tv.tv_sec = 0;  // Без таймаута
-    tv.tv_usec = 0;
-    setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+Task<bool> Protocol::receiveVectorData(Session& session, size_t& bytesReceived) {
+    AsyncSocket& clientSocket = session.socket;
+    OutputQueue& out = session.out;
     
     // Читаем количество векторов
     uint32_t numVectors = 0;
     
-    if (!recvAll(clientSocket, &numVectors, sizeof(uint32_t))) {
-        std::cout << "DEBUG: Ошибка чтения количества векторов" << std::endl;
-        return false;
+    bool gotCount = co_await clientSocket.receive(&numVectors, sizeof(uint32_t), RECV_TIMEOUT_MS);
+    if (!gotCount) {
+        logWarning(session.logger, "Ошибка чтения количества векторов", "login=" + session.login);
+        co_return false;
     }
+    bytesReceived = sizeof(uint32_t);
     
-    std::cout << "DEBUG: Количество векторов: " << numVectors << std::endl;
+    // Расширенный запрос с согласованием типа элементов
+    if (numVectors == Config::EXT_MAGIC) {
+        RequestHeader header;
+        bool gotHeader = co_await clientSocket.receive(&header, sizeof(header), RECV_TIMEOUT_MS);
+        if (!gotHeader) {
+            logWarning(session.logger, "Ошибка чтения заголовка расширенного запроса",
+                       "login=" + session.login);
+            co_return false;
+        }
+        bytesReceived += sizeof(header);
+        
+        co_return co_await receiveTypedVectors(session, header, bytesReceived);
+    }
     
-    // Создаем буфер и добавляем количество векторов
-    binaryData.clear();
-    binaryData.resize(sizeof(uint32_t));
-    memcpy(binaryData.data(), &numVectors, sizeof(uint32_t));
+    // Векторы не копятся за всю сессию: в памяти только текущий,
+    // и его объем учитывается в общем бюджете сервера
+    std::vector<double> currentVector;
+    AdmissionController::BytesReservation reservation;
+    
+    // Суммы копятся в очереди, пока клиент шлет векторы без ожидания
+    out.beginBulk();
     
     // Читаем векторы по одному КАК В ТЗ
     for (uint32_t i = 0; i < numVectors; i++) {
+        bool settled = co_await settleOutput(session);
+        if (!settled) {
+            co_return false;
+        }
+        
         // Читаем размер вектора
         uint32_t vectorSize = 0;
-        if (!recvAll(clientSocket, &vectorSize, sizeof(uint32_t))) {
-            std::cout << "DEBUG: Ошибка чтения размера вектора " << i+1 << std::endl;
-            return false;
+        bool gotSize = co_await clientSocket.receive(&vectorSize, sizeof(uint32_t), RECV_TIMEOUT_MS);
+        if (!gotSize) {
+            logWarning(session.logger, "Ошибка чтения размера вектора",
+                       "login=" + session.login + ", vector=" + std::to_string(i + 1));
+            co_return false;
         }
         
-        std::cout << "DEBUG: Размер вектора " << i+1 << ": " << vectorSize << std::endl;
-        
-        // Добавляем размер вектора в буфер
-        size_t currentSize = binaryData.size();
-        binaryData.resize(currentSize + sizeof(uint32_t));
-        memcpy(binaryData.data() + currentSize, &vectorSize, sizeof(uint32_t));
+        // Объявленный размер проверяем до выделения памяти
+        if (VectorProcessor::checkVectorSize(vectorSize, ElementType::FLOAT64) != ResultStatus::OK) {
+            logWarning(session.logger, "Слишком большой вектор",
+                       "login=" + session.login + ", vector=" + std::to_string(i + 1) +
+                       ", size=" + std::to_string(vectorSize));
+            co_await out.endBulk();
+            co_await sendError(out);
+            co_return false;
+        }
         
         // Читаем данные вектора
-        size_t vectorBytes = vectorSize * sizeof(double);
-        currentSize = binaryData.size();
-        binaryData.resize(currentSize + vectorBytes);
+        size_t vectorBytes = static_cast<size_t>(vectorSize) * sizeof(double);
+        bool reserved = co_await reservation.acquire(session.admission, vectorBytes,
+                                                     Config::ADMISSION_BYTES_WAIT_MS);
+        if (!reserved) {
+            logWarning(session.logger, "Вектор отклонен: нет бюджета памяти",
+                       "login=" + session.login + ", vector=" + std::to_string(i + 1) +
+                       ", bytes=" + std::to_string(vectorBytes));
+            co_await out.endBulk();
+            co_await sendError(out);
+            co_return false;
+        }
         
-        if (!recvAll(clientSocket, binaryData.data() + currentSize, vectorBytes)) {
-            std::cout << "DEBUG: Ошибка чтения данных вектора " << i+1 
-                      << ", нужно байт: " << vectorBytes << std::endl;
-            return false;
+        currentVector.resize(vectorSize);
+        uint64_t stageStarted = FlightRecorder::begin(TraceStage::RECEIVE_VECTOR, session.traceId);
+        bool gotData = co_await clientSocket.receive(currentVector.data(), vectorBytes, RECV_TIMEOUT_MS);
+        FlightRecorder::end(TraceStage::RECEIVE_VECTOR, session.traceId, stageStarted, vectorBytes);
+        if (!gotData) {
+            logWarning(session.logger, "Ошибка чтения данных вектора",
+                       "login=" + session.login + ", vector=" + std::to_string(i + 1) +
+                       ", bytes=" + std::to_string(vectorBytes));
+            co_return false;
         }
+        bytesReceived += sizeof(uint32_t) + vectorBytes;
         
         // Сразу обрабатываем вектор и отправляем результат
         // Это важно - клиент ждет результат после каждого вектора
-        std::vector<double> currentVector(vectorSize);
-        memcpy(currentVector.data(), binaryData.data() + currentSize, vectorBytes);
-        
+        co_await awaitTurn(session);
+        stageStarted = FlightRecorder::begin(TraceStage::COMPUTE, session.traceId);
         double sum = 0;
         for (double val : currentVector) {
             sum += val;
         }
+        FlightRecorder::end(TraceStage::COMPUTE, session.traceId, stageStarted, vectorSize);
+        reservation.release();
         
-        std::cout << "DEBUG: Сумма вектора " << i+1 << ": " << sum << std::endl;
+        // Ставим результат в очередь; уйдет на ближайшей границе
+        if (!out.enqueue(&sum, sizeof(double))) {
+            logWarning(session.logger, "Ошибка отправки результата вектора",
+                       "login=" + session.login + ", vector=" + std::to_string(i + 1));
+            co_return false;
+        }
+    }
+    
+    bool flushed = co_await out.endBulk();
+    if (!flushed) {
+        logWarning(session.logger, "Ошибка отправки результатов", "login=" + session.login);
+        co_return false;
+    }
+    
+    co_return true;
+}
+
+Task<bool> Protocol::receiveTypedVectors(Session& session, const RequestHeader& header, 
+                                         size_t& bytesReceived) {
+    AsyncSocket& clientSocket = session.socket;
+    OutputQueue& out = session.out;
+    
+    if (VectorStore::isStoreOp(header.op)) {
+        co_return co_await receiveStoreRequest(session, header, bytesReceived);
+    }
+    if (header.op == Config::OP_PREFIX || header.op == Config::OP_WINDOW) {
+        co_return co_await receiveRangeRequest(session, header, bytesReceived);
+    }
+    if (header.flags & Config::FLAG_SHARED_MEMORY) {
+        co_return co_await receiveSharedVectors(session, header, bytesReceived);
+    }
+    
+    // Согласование: неизвестная операция, тип элементов или режим сжатия - ERR
+    if (header.op != Config::OP_SUM || !VectorProcessor::isValidElementType(header.elementType) ||
+        !Compression::isValidMode(header.compression)) {
+        co_await sendError(out);
+        co_return false;
+    }
+    bool accepted = co_await sendOk(out);
+    if (!accepted) {
+        co_return false;
+    }
+    
+    ElementType type = static_cast<ElementType>(header.elementType);
+    size_t elemSize = VectorProcessor::elementSize(type);
+    bool saturate = (header.flags & Config::FLAG_SATURATE) != 0;
+    bool exact = (header.flags & Config::FLAG_EXACT) != 0;
+    ByteOrder order = (header.flags & Config::FLAG_BIG_ENDIAN) ? ByteOrder::BIG : ByteOrder::LITTLE;
+    
+    // Буфер одного вектора переиспользуется - весь поток в памяти не держим
+    std::vector<uint8_t> vectorData;
+    DecodeBuffers buffers;
+    AdmissionController::BytesReservation reservation;
+    
+    out.beginBulk();
+    
+    for (uint32_t i = 0; i < header.numVectors; i++) {
+        bool settled = co_await settleOutput(session);
+        if (!settled) {
+            co_return false;
+        }
         
-        // Отправляем результат сразу
-        if (!sendAll(clientSocket, &sum, sizeof(double))) {
-            std::cout << "DEBUG: Ошибка отправки результата вектора " << i+1 << std::endl;
-            return false;
+        uint32_t vectorSize = 0;
+        bool gotSize = co_await clientSocket.receive(&vectorSize, sizeof(uint32_t), RECV_TIMEOUT_MS);
+        if (!gotSize) {
+            co_return false;
+        }
+        vectorSize = VectorProcessor::toHostOrder32(vectorSize, order);
+        
+        // Заголовок проверяется один раз; после ошибки поток не синхронизировать,
+        // поэтому клиент получает статус и соединение закрывается
+        VectorProcessor::TypedSum sum;
+        sum.status = VectorProcessor::checkVectorSize(vectorSize, type);
+        sum.integer = 0;
+        
+        // Сжатый вектор держит в памяти только блок, несжатый - целиком
+        size_t reserveBytes = static_cast<size_t>(vectorSize) * elemSize;
+        if (header.compression != static_cast<uint8_t>(CompressionMode::NONE)) {
+            reserveBytes = std::min(reserveBytes, static_cast<size_t>(Config::COMPRESSION_BLOCK_SIZE) * 2);
+        }
+        if (sum.status == ResultStatus::OK) {
+            bool reserved = co_await reservation.acquire(session.admission, reserveBytes,
+                                                         Config::ADMISSION_BYTES_WAIT_MS);
+            if (!reserved) {
+                sum.status = ResultStatus::BUSY;
+            }
+        }
+        
+        if (sum.status == ResultStatus::OK) {
+            if (header.compression != static_cast<uint8_t>(CompressionMode::NONE)) {
+                VectorProcessor::SumState state;
+                VectorProcessor::beginSum(state, type, exact);
+                uint64_t stageStarted = FlightRecorder::begin(TraceStage::RECEIVE_VECTOR, session.traceId);
+                bool decoded = co_await receiveCompressedVector(clientSocket, vectorSize, header.compression, order,
+                                                                state, buffers, sum.status, session.logger,
+                                                                session.flow);
+                FlightRecorder::end(TraceStage::RECEIVE_VECTOR, session.traceId, stageStarted,
+                                    static_cast<uint64_t>(vectorSize) * elemSize);
+                if (!decoded) {
+                    if (sum.status == ResultStatus::OK) {
+                        co_return false;
+                    }
+                } else {
+                    sum = VectorProcessor::finishSum(state, saturate);
+                    bytesReceived += static_cast<size_t>(vectorSize) * elemSize;
+                }
+            } else {
+                // Весь вектор одним recv в выровненный буфер, затем ядро без проверок
+                vectorData.resize(static_cast<size_t>(vectorSize) * elemSize);
+                uint64_t stageStarted = FlightRecorder::begin(TraceStage::RECEIVE_VECTOR, session.traceId);
+                bool gotData = co_await clientSocket.receive(vectorData.data(), vectorData.size(), RECV_TIMEOUT_MS);
+                FlightRecorder::end(TraceStage::RECEIVE_VECTOR, session.traceId, stageStarted, vectorData.size());
+                if (!gotData) {
+                    co_return false;
+                }
+                bytesReceived += vectorData.size();
+                
+                // Хэш от байтов как они пришли: порядок байтов входит в вид ключа
+                co_await awaitTurn(session);
+                stageStarted = FlightRecorder::begin(TraceStage::COMPUTE, session.traceId);
+                ResultCache::Key key;
+                bool cacheable = session.cache != nullptr && 
+                                 ResultCache::worthCaching(type, vectorData.size());
+                if (cacheable) {
+                    key = session.cache->makeKey(ResultCache::kindOf(type, header.flags), session.login,
+                                                 vectorData.data(), vectorData.size());
+                }
+                
+                if (!cacheable || !session.cache->lookup(key, sum)) {
+                    VectorProcessor::toHostOrder(vectorData.data(), vectorSize, elemSize, order);
+                    sum = VectorProcessor::sumTyped(type, vectorData.data(), vectorSize, saturate, exact);
+                    if (cacheable) {
+                        session.cache->insert(key, sum);
+                    }
+                }
+                FlightRecorder::end(TraceStage::COMPUTE, session.traceId, stageStarted, vectorSize);
+            }
+        }
+        
+        if (!queueTypedReply(out, type, sum, order)) {
+            co_return false;
+        }
+        
+        reservation.release();
+        bytesReceived += sizeof(uint32_t);
+        
+        if (sum.status == ResultStatus::OVERSIZE || sum.status == ResultStatus::MALFORMED ||
+            sum.status == ResultStatus::BUSY) {
+            logWarning(session.logger, "Ошибка в векторе, прием прекращен",
+                       "login=" + session.login + ", vector=" + std::to_string(i + 1) +
+                       ", status=" + std::to_string(static_cast<int>(sum.status)));
+            co_await out.endBulk();
+            co_return false;
         }
     }
     
-    std::cout << "DEBUG: Всего получено байт: " << binaryData.size() << std::endl;
-    return true;
+    co_return co_await out.endBulk();
 }
 
+Task<bool> Protocol::receiveSharedVectors(Session& session, const RequestHeader& header,
+                                          size_t& bytesReceived) {
+    AsyncSocket& clientSocket = session.socket;
+    OutputQueue& out = session.out;
+    
+    // Общая память - только по Unix-сокету; элементы в порядке байтов хоста
+    // и без сжатия: сервер читает их из региона как есть
+    ByteOrder order = (header.flags & Config::FLAG_BIG_ENDIAN) ? ByteOrder::BIG : ByteOrder::LITTLE;
+    if (!session.local || header.op != Config::OP_SUM ||
+        !VectorProcessor::isValidElementType(header.elementType) ||
+        header.compression != static_cast<uint8_t>(CompressionMode::NONE) ||
+        VectorProcessor::needsSwap(order)) {
+        co_await sendError(out);
+        co_return false;
+    }
+    bool accepted = co_await sendOk(out);
+    if (!accepted) {
+        co_return false;
+    }
+    
+    // Размер региона и его memfd приходят одним сообщением
+    uint64_t regionSize = 0;
+    int regionFd = -1;
+    bool gotRegion = co_await clientSocket.receiveWithFd(&regionSize, sizeof(regionSize), regionFd,
+                                                         RECV_TIMEOUT_MS);
+    if (!gotRegion) {
+        co_return false;
+    }
+    bytesReceived += sizeof(regionSize);
+    
+    // Отображение остается действительным и после закрытия дескриптора
+    SharedRegion::Mapping mapping;
+    std::string error = "дескриптор не передан";
+    bool mapped = regionFd >= 0 && SharedRegion::map(regionFd, regionSize, mapping, error);
+    if (regionFd >= 0) {
+        close(regionFd);
+    }
+    if (!mapped) {
+        logWarning(session.logger, "Регион общей памяти отклонен",
+                   "login=" + session.login + ", size=" + std::to_string(regionSize) + ", error=" + error);
+        co_await sendError(out);
+        co_return false;
+    }
+    struct RegionRelease {
+        SharedRegion::Mapping& mapping;
+        ~RegionRelease() { SharedRegion::unmap(mapping); }
+    } regionRelease{mapping};
+    
+    bool mappedOk = co_await sendOk(out);
+    if (!mappedOk) {
+        co_return false;
+    }
+    
+    ElementType type = static_cast<ElementType>(header.elementType);
+    size_t elemSize = VectorProcessor::elementSize(type);
+    bool saturate = (header.flags & Config::FLAG_SATURATE) != 0;
+    bool exact = (header.flags & Config::FLAG_EXACT) != 0;
+    
+    out.beginBulk();
+    
+    for (uint32_t i = 0; i < header.numVectors; i++) {
+        bool settled = co_await settleOutput(session);
+        if (!settled) {
+            co_return false;
+        }
+        
+        // Дескриптор вектора: [u64 смещение в регионе][u32 число элементов]
+        uint8_t descriptor[sizeof(uint64_t) + sizeof(uint32_t)];
+        bool gotDescriptor = co_await clientSocket.receive(descriptor, sizeof(descriptor), RECV_TIMEOUT_MS);
+        if (!gotDescriptor) {
+            co_return false;
+        }
+        bytesReceived += sizeof(descriptor);
+        
+        uint64_t offset;
+        uint32_t count;
+        memcpy(&offset, descriptor, sizeof(offset));
+        memcpy(&count, descriptor + sizeof(offset), sizeof(count));
+        
+        VectorProcessor::TypedSum sum;
+        sum.status = VectorProcessor::checkVectorSize(count, type);
+        sum.integer = 0;
+        
+        const uint8_t* data = nullptr;
+        if (sum.status == ResultStatus::OK) {
+            data = SharedRegion::span(mapping, offset, count, elemSize);
+            if (data == nullptr) {
+                sum.status = ResultStatus::MALFORMED;
+            }
+        }
+        
+        // Сумма прямо из памяти клиента, без копии в буфер сессии
+        if (sum.status == ResultStatus::OK) {
+            co_await awaitTurn(session);
+            sum = VectorProcessor::sumTyped(type, data, count, saturate, exact);
+        }
+        
+        if (!queueTypedReply(out, type, sum, order)) {
+            co_return false;
+        }
+        
+        // Ошибочный дескриптор - признак рассинхронизации клиента
+        if (sum.status == ResultStatus::OVERSIZE || sum.status == ResultStatus::MALFORMED) {
+            co_await out.endBulk();
+            co_return false;
+        }
+    }
+    
+    co_return co_await out.endBulk();
+}
+
+Task<bool> Protocol::receiveStoreRequest(Session& session, const RequestHeader& header,
+                                         size_t& bytesReceived) {
+    AsyncSocket& clientSocket = session.socket;
+    OutputQueue& out = session.out;
+    
+    // Хранилище держит double: принимаются float32/float64 без сжатия.
+    // Суммы блоков хранятся приближенными - точного режима у хранилища нет
+    ElementType type = static_cast<ElementType>(header.elementType);
+    if (session.store == nullptr || 
+        (type != ElementType::FLOAT32 && type != ElementType::FLOAT64) ||
+        header.compression != static_cast<uint8_t>(CompressionMode::NONE) ||
+        (header.flags & Config::FLAG_EXACT)) {
+        co_await sendError(out);
+        co_return false;
+    }
+    bool accepted = co_await sendOk(out);
+    if (!accepted) {
+        co_return false;
+    }
+    
+    ByteOrder order = (header.flags & Config::FLAG_BIG_ENDIAN) ? ByteOrder::BIG : ByteOrder::LITTLE;
+    
+    uint8_t nameLength = 0;
+    std::string name;
+    bool gotLength = co_await clientSocket.receive(&nameLength, sizeof(nameLength), RECV_TIMEOUT_MS);
+    if (!gotLength) {
+        co_return false;
+    }
+    name.resize(nameLength);
+    if (nameLength > 0) {
+        bool gotName = co_await clientSocket.receive(&name[0], nameLength, RECV_TIMEOUT_MS);
+        if (!gotName) {
+            co_return false;
+        }
+    }
+    bytesReceived += sizeof(nameLength) + nameLength;
+    
+    VectorStore& store = *session.store;
+    VectorStore::Aggregates aggregates = {0.0, 0, 0.0, 0.0};
+    std::vector<uint8_t> raw;
+    std::vector<double> values;
+    AdmissionController::BytesReservation reservation;
+    
+    // Ответ на запрос агрегатов: статус, сумма, число элементов, минимум, максимум;
+    // на остальные операции - статус и сумма, как для вектора
+    auto reply = [&](ResultStatus status, bool full) {
+        uint8_t buffer[1 + 4 * sizeof(double)];
+        buffer[0] = static_cast<uint8_t>(status);
+        memcpy(buffer + 1, &aggregates.sum, sizeof(double));
+        memcpy(buffer + 1 + sizeof(double), &aggregates.count, sizeof(uint64_t));
+        memcpy(buffer + 1 + 2 * sizeof(double), &aggregates.min, sizeof(double));
+        memcpy(buffer + 1 + 3 * sizeof(double), &aggregates.max, sizeof(double));
+        size_t words = full ? 4 : 1;
+        VectorProcessor::toHostOrder(buffer + 1, words, sizeof(double), order);
+        return out.enqueue(buffer, 1 + words * sizeof(double));
+    };
+    
+    if (!VectorStore::isValidName(name)) {
+        reply(ResultStatus::MALFORMED, false);
+        co_await out.flush();
+        co_return false;
+    }
+    
+    ResultStatus status = ResultStatus::OK;
+    bool full = false;
+    switch (header.op) {
+        case Config::OP_CREATE:
+            status = store.create(session.login, name);
+            break;
+            
+        case Config::OP_DROP:
+            status = store.drop(session.login, name);
+            break;
+            
+        case Config::OP_QUERY:
+            status = store.query(session.login, name, aggregates);
+            full = true;
+            break;
+            
+        case Config::OP_UPDATE: {
+            uint64_t offset = 0;
+            bool gotOffset = co_await clientSocket.receive(&offset, sizeof(offset), RECV_TIMEOUT_MS);
+            if (!gotOffset) {
+                co_return false;
+            }
+            VectorProcessor::toHostOrder(reinterpret_cast<uint8_t*>(&offset), 1, sizeof(offset), order);
+            bytesReceived += sizeof(offset);
+            
+            bool gotElements = co_await receiveStoreElements(session, type, order, raw, values,
+                                                             reservation, status, bytesReceived);
+            if (!gotElements) {
+                co_return false;
+            }
+            if (status == ResultStatus::OK) {
+                status = store.update(session.login, name, offset, values.data(), values.size(), aggregates);
+            }
+            reservation.release();
+            break;
+        }
+        
+        default: {
+            // OP_APPEND: numVectors пакетов подряд, ответ на каждый
+            out.beginBulk();
+            for (uint32_t i = 0; i < header.numVectors; i++) {
+                bool settled = co_await settleOutput(session);
+                if (!settled) {
+                    co_return false;
+                }
+                
+                bool gotElements = co_await receiveStoreElements(session, type, order, raw, values,
+                                                                 reservation, status, bytesReceived);
+                if (!gotElements) {
+                    co_return false;
+                }
+                if (status == ResultStatus::OK) {
+                    status = store.append(session.login, name, values.data(), values.size(), aggregates);
+                }
+                reservation.release();
+                if (!reply(status, false)) {
+                    co_return false;
+                }
+                
+                // Пакет прочитан целиком - после QUOTA или NOT_FOUND поток в порядке
+                if (status == ResultStatus::OVERSIZE || status == ResultStatus::BUSY) {
+                    co_await out.endBulk();
+                    co_return false;
+                }
+            }
+            co_return co_await out.endBulk();
+        }
+    }
+    
+    // Одиночная операция: ответ уходит сразу
+    bool replied = reply(status, full);
+    if (replied) {
+        replied = co_await out.flush();
+    }
+    co_return replied && status != ResultStatus::OVERSIZE && status != ResultStatus::BUSY;
+}
+
+Task<bool> Protocol::receiveRangeRequest(Session& session, const RequestHeader& header,
+                                         size_t& bytesReceived) {
+    AsyncSocket& clientSocket = session.socket;
+    OutputQueue& out = session.out;
+    
+    // Суммы считаются в double: принимаются float32/float64 без сжатия,
+    // префиксы - по Ноймайеру, без точного режима
+    ElementType type = static_cast<ElementType>(header.elementType);
+    if ((type != ElementType::FLOAT32 && type != ElementType::FLOAT64) ||
+        header.compression != static_cast<uint8_t>(CompressionMode::NONE) ||
+        (header.flags & Config::FLAG_EXACT)) {
+        co_await sendError(out);
+        co_return false;
+    }
+    bool accepted = co_await sendOk(out);
+    if (!accepted) {
+        co_return false;
+    }
+    
+    ByteOrder order = (header.flags & Config::FLAG_BIG_ENDIAN) ? ByteOrder::BIG : ByteOrder::LITTLE;
+    bool windows = header.op == Config::OP_WINDOW;
+    
+    uint32_t window[2] = {0, 0};  // ширина и шаг
+    if (windows) {
+        bool gotWindow = co_await clientSocket.receive(window, sizeof(window), RECV_TIMEOUT_MS);
+        if (!gotWindow) {
+            co_return false;
+        }
+        window[0] = VectorProcessor::toHostOrder32(window[0], order);
+        window[1] = VectorProcessor::toHostOrder32(window[1], order);
+        bytesReceived += sizeof(window);
+    }
+    
+    // Заголовок ответа на вектор: статус и число сумм, следующих за ним
+    auto replyHeader = [&](ResultStatus status, uint32_t count) {
+        uint8_t buffer[1 + sizeof(uint32_t)];
+        buffer[0] = static_cast<uint8_t>(status);
+        count = VectorProcessor::toHostOrder32(count, order);
+        memcpy(buffer + 1, &count, sizeof(count));
+        return out.enqueue(buffer, sizeof(buffer));
+    };
+    
+    if (windows && (window[0] == 0 || window[1] == 0)) {
+        replyHeader(ResultStatus::MALFORMED, 0);
+        co_await out.flush();
+        co_return false;
+    }
+    
+    std::vector<uint8_t> raw;
+    std::vector<double> values;
+    std::vector<double> batch(Config::RANGE_BATCH_RESULTS);
+    AdmissionController::BytesReservation reservation;
+    
+    // Пакет сумм копируется в очередь и уходит полными сегментами под TCP_CORK,
+    // клиент начинает читать, не дожидаясь конца вектора
+    auto queueBatch = [&](size_t count) {
+        VectorProcessor::toHostOrder(reinterpret_cast<uint8_t*>(batch.data()), count,
+                                     sizeof(double), order);
+        return out.enqueue(batch.data(), count * sizeof(double));
+    };
+    
+    out.beginBulk();
+    
+    for (uint32_t i = 0; i < header.numVectors; i++) {
+        bool settled = co_await settleOutput(session);
+        if (!settled) {
+            co_return false;
+        }
+        
+        ResultStatus status = ResultStatus::OK;
+        bool gotElements = co_await receiveStoreElements(session, type, order, raw, values,
+                                                         reservation, status, bytesReceived);
+        if (!gotElements) {
+            co_return false;
+        }
+        
+        uint64_t resultCount = 0;
+        if (status == ResultStatus::OK) {
+            resultCount = windows ? RangeSums::windowCount(values.size(), window[0], window[1])
+                                  : values.size();
+        }
+        if (!replyHeader(status, static_cast<uint32_t>(resultCount))) {
+            co_return false;
+        }
+        if (status != ResultStatus::OK) {
+            co_await out.endBulk();
+            co_return false;
+        }
+        
+        if (windows) {
+            RangeSums::WindowCursor cursor;
+            RangeSums::beginWindows(cursor, values.data(), values.size(), window[0], window[1]);
+            size_t produced;
+            while ((produced = RangeSums::nextWindows(cursor, batch.data(), batch.size())) > 0) {
+                bool queued = queueBatch(produced);
+                if (queued && out.congested()) {
+                    queued = co_await out.drain();
+                    if (queued) {
+                        co_await awaitTurn(session);
+                    }
+                }
+                if (!queued) {
+                    co_return false;
+                }
+            }
+        } else {
+            RangeSums::Accumulator acc;
+            RangeSums::reset(acc);
+            for (size_t offset = 0; offset < values.size(); offset += batch.size()) {
+                size_t count = std::min(batch.size(), values.size() - offset);
+                RangeSums::prefix(acc, values.data() + offset, count, batch.data());
+                bool queued = queueBatch(count);
+                if (queued && out.congested()) {
+                    queued = co_await out.drain();
+                    if (queued) {
+                        co_await awaitTurn(session);
+                    }
+                }
+                if (!queued) {
+                    co_return false;
+                }
+            }
+        }
+        reservation.release();
+    }
+    
+    co_return co_await out.endBulk();
+}
+
+Task<bool> Protocol::receiveStoreElements(Session& session, ElementType type, ByteOrder order,
+                                          std::vector<uint8_t>& raw, std::vector<double>& values,
+                                          AdmissionController::BytesReservation& reservation,
+                                          ResultStatus& status, size_t& bytesReceived) {
+    uint32_t count = 0;
+    bool gotCount = co_await session.socket.receive(&count, sizeof(count), RECV_TIMEOUT_MS);
+    if (!gotCount) {
+        co_return false;
+    }
+    count = VectorProcessor::toHostOrder32(count, order);
+    bytesReceived += sizeof(count);
+    
+    status = VectorProcessor::checkVectorSize(count, type);
+    if (status != ResultStatus::OK) {
+        co_return true;
+    }
+    
+    // raw и values учитываются в общем бюджете, пока вызывающий
+    // не закончит с ними операцию хранилища или диапазонные суммы
+    size_t elemSize = VectorProcessor::elementSize(type);
+    size_t bytes = static_cast<size_t>(count) * elemSize;
+    bool reserved = co_await reservation.acquire(session.admission, bytes + count * sizeof(double),
+                                        Config::ADMISSION_BYTES_WAIT_MS);
+    if (!reserved) {
+        status = ResultStatus::BUSY;
+        co_return true;
+    }
+    
+    raw.resize(bytes);
+    bool gotData = co_await session.socket.receive(raw.data(), bytes, RECV_TIMEOUT_MS);
+    if (!gotData) {
+        co_return false;
+    }
+    bytesReceived += bytes;
+    
+    // Перевод и следующая за ним операция хранилища или диапазонные суммы - в ход логина
+    co_await awaitTurn(session);
+    VectorProcessor::toHostOrder(raw.data(), count, elemSize, order);
+    
+    values.resize(count);
+    if (type == ElementType::FLOAT64) {
+        memcpy(values.data(), raw.data(), bytes);
+    } else {
+        const float* floats = reinterpret_cast<const float*>(raw.data());
+        for (uint32_t i = 0; i < count; i++) {
+            values[i] = floats[i];
+        }
+    }
+    co_return true;
+}
+
+Task<bool> Protocol::receiveCompressedVector(AsyncSocket& clientSocket, uint32_t vectorSize,
+                                             uint8_t compression, ByteOrder order,
+                                             VectorProcessor::SumState& state,
+                                             DecodeBuffers& buffers, ResultStatus& status,
+                                             Logger* logger, FairScheduler::Flow* flow) {
+    size_t elemSize = VectorProcessor::elementSize(state.type);
+    size_t remaining = static_cast<size_t>(vectorSize) * elemSize;
+    uint64_t prev = 0;  // состояние XOR-дельты сбрасывается на каждый вектор
+    
+    while (remaining > 0) {
+        // Заголовок блока: размер до и после кодирования
+        uint32_t blockHeader[2];
+        bool gotHeader = co_await clientSocket.receive(blockHeader, sizeof(blockHeader), RECV_TIMEOUT_MS);
+        if (!gotHeader) {
+            co_return false;
+        }
+        
+        size_t rawBytes = VectorProcessor::toHostOrder32(blockHeader[0], order);
+        size_t encodedBytes = VectorProcessor::toHostOrder32(blockHeader[1], order);
+        if (rawBytes == 0 || rawBytes > remaining || rawBytes % elemSize != 0 ||
+            rawBytes > static_cast<size_t>(Config::COMPRESSION_BLOCK_SIZE) ||
+            encodedBytes == 0 || encodedBytes > rawBytes) {
+            logWarning(logger, "Некорректный блок сжатых данных",
+                       "raw=" + std::to_string(rawBytes) + ", encoded=" + std::to_string(encodedBytes));
+            status = ResultStatus::MALFORMED;
+            co_return false;
+        }
+        
+        buffers.encoded.resize(encodedBytes);
+        bool gotBlock = co_await clientSocket.receive(buffers.encoded.data(), encodedBytes, RECV_TIMEOUT_MS);
+        if (!gotBlock) {
+            co_return false;
+        }
+        
+        // Перестановка и XOR-дельта не зависят от порядка байтов,
+        // поэтому порядок хоста восстанавливается уже после распаковки
+        co_await FairScheduler::turn(flow);
+        buffers.block.resize(rawBytes);
+        if (!Compression::decodeBlock(buffers.encoded.data(), encodedBytes, rawBytes, elemSize,
+                                      compression, prev, buffers.scratch, buffers.block.data())) {
+            logWarning(logger, "Ошибка распаковки блока",
+                       "raw=" + std::to_string(rawBytes) + ", encoded=" + std::to_string(encodedBytes));
+            status = ResultStatus::MALFORMED;
+            co_return false;
+        }
+        
+        size_t count = rawBytes / elemSize;
+        VectorProcessor::toHostOrder(buffers.block.data(), count, elemSize, order);
+        VectorProcessor::accumulate(state, buffers.block.data(), count);
+        remaining -= rawBytes;
+    }
+    
+    co_return true;
+}
 
 bool Protocol::sendAll(int socket, const void* buffer, size_t length) {
     const char* ptr = static_cast<const char*>(buffer);
@@ -196,8 +868,6 @@ bool Protocol::recvAll(int socket, void* buffer, size_t length) {
         ssize_t received = recv(socket, ptr + bytesReceived, length - bytesReceived, 0);
         
         if (received <= 0) {
-            std::cout << "DEBUG: recvAll ошибка, получено: " << received 
-                      << ", ожидалось: " << length << " байт, получено всего: " << bytesReceived << std::endl;
             return false;
         }
         
@@ -207,3 +877,66 @@ bool Protocol::recvAll(int socket, void* buffer, size_t length) {
     return true;
 }
 
+Task<bool> Protocol::settleOutput(Session& session) {
+    AsyncSocket& clientSocket = session.socket;
+    OutputQueue& out = session.out;
+    
+    // Клиент не читает ответы - ждем его, а не копим их в памяти
+    if (out.congested()) {
+        uint64_t stageStarted = FlightRecorder::begin(TraceStage::FLUSH, session.traceId);
+        bool drained = co_await out.drain();
+        FlightRecorder::end(TraceStage::FLUSH, session.traceId, stageStarted);
+        if (!drained) {
+            co_return false;
+        }
+    }
+    
+    // Перед ожиданием следующего вектора отдаем накопленные ответы:
+    // клиент, ждущий результат после каждого вектора, не должен зависнуть
+    if (out.hasPending() && !clientSocket.hasBufferedInput() && !inputPending(clientSocket.get())) {
+        uint64_t stageStarted = FlightRecorder::begin(TraceStage::FLUSH, session.traceId);
+        bool flushed = co_await out.flush();
+        FlightRecorder::end(TraceStage::FLUSH, session.traceId, stageStarted);
+        if (!flushed) {
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+Task<void> Protocol::awaitTurn(Session& session) {
+    // Поток сначала отдаст ход более срочным логинам и тем, кто потратил
+    // меньше своей доли. Ход берется после приема: вектор, пришедший по
+    // частям, возобновляется из epoll, и ход до приема не покрыл бы сумму
+    uint64_t stageStarted = FlightRecorder::begin(TraceStage::SCHEDULER_WAIT, session.traceId);
+    co_await FairScheduler::turn(session.flow);
+    FlightRecorder::end(TraceStage::SCHEDULER_WAIT, session.traceId, stageStarted);
+}
+
+void Protocol::logWarning(Logger* logger, const std::string& message, const std::string& params) {
+    if (logger != nullptr) {
+        logger->log(LogLevel::WARNING, message, params);
+    }
+}
+
+bool Protocol::queueTypedReply(OutputQueue& out, ElementType type, const VectorProcessor::TypedSum& sum,
+                               ByteOrder order) {
+    // Байт статуса и 8 байт значения (double или int64) в порядке клиента
+    uint8_t reply[1 + sizeof(int64_t)];
+    reply[0] = static_cast<uint8_t>(sum.status);
+    if (VectorProcessor::isIntegerType(type)) {
+        memcpy(reply + 1, &sum.integer, sizeof(int64_t));
+    } else {
+        memcpy(reply + 1, &sum.real, sizeof(double));
+    }
+    VectorProcessor::toHostOrder(reply + 1, 1, sizeof(int64_t), order);
+    return out.enqueue(reply, sizeof(reply));
+}
+
+bool Protocol::inputPending(int socket) {
+    int available = 0;
+    if (ioctl(socket, FIONREAD, &available) < 0) {
+        return false;
+    }
+    return available > 0;
+}
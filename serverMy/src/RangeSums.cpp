@@ -0,0 +1,76 @@
+#include "RangeSums.h"
+#include <cmath>
+
+namespace {
+    // Ноймайер: ошибка каждого сложения копится отдельно и точно
+    // до порядка eps^2, даже когда слагаемое больше накопленной суммы
+    inline void compensatedAdd(RangeSums::Accumulator& acc, double value) {
+        double t = acc.sum + value;
+        if (std::fabs(acc.sum) >= std::fabs(value)) {
+            acc.compensation += (acc.sum - t) + value;
+        } else {
+            acc.compensation += (value - t) + acc.sum;
+        }
+        acc.sum = t;
+    }
+
+    inline void advance(RangeSums::Accumulator& acc, const double* data, uint64_t& position,
+                        uint64_t target) {
+        for (; position < target; position++) {
+            compensatedAdd(acc, data[position]);
+        }
+    }
+}
+
+void RangeSums::reset(Accumulator& acc) {
+    acc.sum = 0.0;
+    acc.compensation = 0.0;
+}
+
+void RangeSums::prefix(Accumulator& acc, const double* data, size_t count, double* out) {
+    // Локальные копии - компилятор держит состояние в регистрах
+    Accumulator local = acc;
+    for (size_t i = 0; i < count; i++) {
+        compensatedAdd(local, data[i]);
+        out[i] = local.sum + local.compensation;
+    }
+    acc = local;
+}
+
+uint64_t RangeSums::windowCount(uint64_t count, uint32_t width, uint32_t stride) {
+    if (width == 0 || stride == 0 || count < width) {
+        return 0;
+    }
+    return (count - width) / stride + 1;
+}
+
+void RangeSums::beginWindows(WindowCursor& cursor, const double* data, uint64_t count,
+                             uint32_t width, uint32_t stride) {
+    cursor.data = data;
+    cursor.count = count;
+    cursor.width = width;
+    cursor.stride = stride;
+    cursor.emitted = 0;
+    cursor.lead = 0;
+    cursor.trail = 0;
+    reset(cursor.leadSum);
+    reset(cursor.trailSum);
+}
+
+size_t RangeSums::nextWindows(WindowCursor& cursor, double* out, size_t maxOut) {
+    uint64_t total = windowCount(cursor.count, cursor.width, cursor.stride);
+    size_t produced = 0;
+
+    // Оба края только движутся вперед: каждый элемент складывается
+    // не больше двух раз при любых ширине и шаге
+    while (produced < maxOut && cursor.emitted < total) {
+        uint64_t start = cursor.emitted * cursor.stride;
+        advance(cursor.trailSum, cursor.data, cursor.trail, start);
+        advance(cursor.leadSum, cursor.data, cursor.lead, start + cursor.width);
+
+        out[produced++] = (cursor.leadSum.sum - cursor.trailSum.sum) +
+                          (cursor.leadSum.compensation - cursor.trailSum.compensation);
+        cursor.emitted++;
+    }
+    return produced;
+}
@@ -0,0 +1,199 @@
+#include "ResultCache.h"
+#include "Config.h"
+#include <cstring>
+#include <random>
+#include <algorithm>
+
+namespace {
+    // XXH64: простые множители и раунды по эталонной реализации
+    const uint64_t PRIME1 = 11400714785074694791ULL;
+    const uint64_t PRIME2 = 14029467366897019727ULL;
+    const uint64_t PRIME3 = 1609587929392839161ULL;
+    const uint64_t PRIME4 = 9650029242287828579ULL;
+    const uint64_t PRIME5 = 2870177450012600261ULL;
+
+    inline uint64_t rotl(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    // Чтение без требований к выравниванию; хэш считается от байтов
+    // в памяти как есть, на little-endian хосте совпадает с эталоном
+    inline uint64_t read64(const uint8_t* ptr) {
+        uint64_t value;
+        memcpy(&value, ptr, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t read32(const uint8_t* ptr) {
+        uint32_t value;
+        memcpy(&value, ptr, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t mixRound(uint64_t acc, uint64_t input) {
+        acc += input * PRIME2;
+        acc = rotl(acc, 31);
+        return acc * PRIME1;
+    }
+
+    inline uint64_t mergeRound(uint64_t acc, uint64_t value) {
+        acc ^= mixRound(0, value);
+        return acc * PRIME1 + PRIME4;
+    }
+
+    uint64_t randomSeed() {
+        std::random_device rd;
+        return (static_cast<uint64_t>(rd()) << 32) ^ rd();
+    }
+}
+
+ResultCache::ResultCache(size_t capacity)
+    : capacity(capacity),
+      shardCount(std::max<size_t>(1, std::min(capacity, SHARD_COUNT))),
+      seed(randomSeed()),
+      shards(new Shard[shardCount]),
+      hits(0), misses(0), evictions(0), bytesSaved(0) {
+    // Остаток деления раздается первым шардам - лимит не превышается
+    for (size_t i = 0; i < shardCount; i++) {
+        shards[i].capacity = capacity / shardCount + (i < capacity % shardCount ? 1 : 0);
+    }
+}
+
+uint32_t ResultCache::kindOf(ElementType type, uint8_t flags) {
+    uint8_t significant = flags & (Config::FLAG_SATURATE | Config::FLAG_BIG_ENDIAN | Config::FLAG_EXACT);
+    return static_cast<uint32_t>(type) | (static_cast<uint32_t>(significant) << 8);
+}
+
+bool ResultCache::worthCaching(ElementType type, size_t bytes) {
+    return type == ElementType::FLOAT64 && bytes >= Config::RESULT_CACHE_MIN_BYTES;
+}
+
+uint64_t ResultCache::hash(const void* data, size_t length, uint64_t seed) {
+    const uint8_t* ptr = static_cast<const uint8_t*>(data);
+    const uint8_t* end = ptr + length;
+    uint64_t h;
+
+    if (length >= 32) {
+        // Четыре независимые цепочки по 8 байт - хэш идет со скоростью памяти
+        uint64_t v1 = seed + PRIME1 + PRIME2;
+        uint64_t v2 = seed + PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME1;
+        const uint8_t* limit = end - 32;
+
+        do {
+            v1 = mixRound(v1, read64(ptr));
+            v2 = mixRound(v2, read64(ptr + 8));
+            v3 = mixRound(v3, read64(ptr + 16));
+            v4 = mixRound(v4, read64(ptr + 24));
+            ptr += 32;
+        } while (ptr <= limit);
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + PRIME5;
+    }
+
+    h += static_cast<uint64_t>(length);
+
+    while (ptr + 8 <= end) {
+        h ^= mixRound(0, read64(ptr));
+        h = rotl(h, 27) * PRIME1 + PRIME4;
+        ptr += 8;
+    }
+    if (ptr + 4 <= end) {
+        h ^= static_cast<uint64_t>(read32(ptr)) * PRIME1;
+        h = rotl(h, 23) * PRIME2 + PRIME3;
+        ptr += 4;
+    }
+    while (ptr < end) {
+        h ^= static_cast<uint64_t>(*ptr) * PRIME5;
+        h = rotl(h, 11) * PRIME1;
+        ptr++;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+ResultCache::Key ResultCache::makeKey(uint32_t kind, const std::string& login,
+                                      const void* data, size_t length) const {
+    Key key;
+    key.scope = hash(login.data(), login.size(), seed);
+    key.hash = hash(data, length, key.scope);
+    key.bytes = length;
+    key.kind = kind;
+    return key;
+}
+
+ResultCache::Shard& ResultCache::shardFor(const Key& key) const {
+    // Старшие биты - на шард, младшие использует хэш-таблица внутри шарда
+    return shards[(key.hash >> 32) % shardCount];
+}
+
+bool ResultCache::lookup(const Key& key, VectorProcessor::TypedSum& result) {
+    Shard& shard = shardFor(key);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            result = it->second->second;
+            hits.fetch_add(1, std::memory_order_relaxed);
+            bytesSaved.fetch_add(key.bytes, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void ResultCache::insert(const Key& key, const VectorProcessor::TypedSum& result) {
+    if (capacity == 0) {
+        return;
+    }
+
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // Одинаковый вектор могли одновременно посчитать две сессии
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        it->second->second = result;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+
+    if (shard.lru.size() >= shard.capacity) {
+        shard.index.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    shard.lru.emplace_front(key, result);
+    shard.index[key] = shard.lru.begin();
+}
+
+ResultCache::Stats ResultCache::stats() const {
+    Stats result;
+    result.hits = hits.load(std::memory_order_relaxed);
+    result.misses = misses.load(std::memory_order_relaxed);
+    result.evictions = evictions.load(std::memory_order_relaxed);
+    result.bytesSaved = bytesSaved.load(std::memory_order_relaxed);
+    result.entries = 0;
+
+    for (size_t i = 0; i < shardCount; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        result.entries += shards[i].lru.size();
+    }
+    return result;
+}
@@ -3,20 +3,124 @@
 #include "ClientDB.h"
 #include "Protocol.h"
 #include "VectorProcessor.h"
+#include "OutputQueue.h"
+#include "Session.h"
+#include "SocketHandoff.h"
+#include "NumaPlacement.h"
+#include "ResultCache.h"
+#include "VectorStore.h"
+#include "StoreSnapshot.h"
+#include "Executor.h"
+#include "FairScheduler.h"
+#include "AsyncSocket.h"
+#include "TlsContext.h"
+#include "FlightRecorder.h"
 #include "Config.h"
 #include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <cstring>
 #include <iostream>
 #include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
 
 Server::Server(int port, const std::string& clientDbFile, const std::string& logFile)
-    : port(port), serverSocket(-1), running(false) {
+    : port(port), serverSocket(-1), signalFd(-1), wakeFd(-1), handoffSocket(-1), unixSocket(-1),
+      unixInode(0), tlsPort(0), tlsSocket(-1), upgradePid(-1),
+      drainTimeoutSec(Config::DEFAULT_DRAIN_TIMEOUT_SEC), acceptorCpu(-1), numaSteering(false),
+      workerThreads(0), running(false), drained(false),
+      snapshotIntervalSec(Config::DEFAULT_SNAPSHOT_INTERVAL_SEC), snapshotPid(-1), handedOff(false),
+      traceFile(Config::DEFAULT_TRACE_FILE_NAME) {
     
     logger = std::make_unique<Logger>(logFile);
+    // Дамп самописца по умолчанию - в каталоге журнала
+    std::string::size_type slash = logFile.rfind('/');
+    if (slash != std::string::npos) {
+        traceFile = logFile.substr(0, slash + 1) + Config::DEFAULT_TRACE_FILE_NAME;
+    }
     clientDB = std::make_unique<ClientDB>(clientDbFile);
+    
+    AdmissionController::Limits limits;
+    limits.maxConnections = Config::DEFAULT_MAX_CONNECTIONS;
+    limits.maxInflightBytes = static_cast<size_t>(Config::DEFAULT_MAX_INFLIGHT_MB) * 1024 * 1024;
+    limits.maxSessionsPerLogin = Config::DEFAULT_MAX_SESSIONS_PER_LOGIN;
+    admission = std::make_unique<AdmissionController>(limits);
+    store = std::make_unique<VectorStore>(static_cast<size_t>(Config::DEFAULT_STORE_QUOTA_MB) * 1024 * 1024);
+}
+
+void Server::setAdmissionLimits(const AdmissionController::Limits& limits) {
+    admission = std::make_unique<AdmissionController>(limits);
+}
+
+void Server::setDrainTimeout(int seconds) {
+    drainTimeoutSec = seconds;
+}
+
+void Server::setHandoffPath(const std::string& path) {
+    handoffPath = path;
+}
+
+void Server::setTakeoverPath(const std::string& path) {
+    takeoverPath = path;
+}
+
+void Server::setUpgradeCommand(const std::vector<std::string>& command) {
+    upgradeCommand = command;
+}
+
+void Server::setUnixPath(const std::string& path) {
+    unixPath = path;
+}
+
+void Server::setTls(int port, const std::string& certFile, const std::string& keyFile) {
+    tlsPort = port;
+    tlsCertFile = certFile;
+    tlsKeyFile = keyFile;
+}
+
+void Server::setResultCache(size_t entries) {
+    if (entries > 0) {
+        resultCache = std::make_unique<ResultCache>(entries);
+    } else {
+        resultCache.reset();
+    }
+}
+
+void Server::setStoreQuota(size_t bytes) {
+    if (bytes > 0) {
+        store = std::make_unique<VectorStore>(bytes);
+    } else {
+        store.reset();
+    }
+}
+
+void Server::setSnapshot(const std::string& path, int intervalSec) {
+    snapshotPath = path;
+    snapshotIntervalSec = intervalSec;
+}
+
+void Server::setTraceFile(const std::string& path) {
+    traceFile = path;
+}
+
+void Server::setCpuPlacement(const std::vector<int>& cpus, int acceptorCpu, bool numaSteering) {
+    workerCpus = cpus;
+    this->acceptorCpu = acceptorCpu;
+    this->numaSteering = numaSteering;
+}
+
+void Server::setWorkerThreads(size_t threads) {
+    workerThreads = threads;
 }
 
 Server::~Server() {
@@ -37,31 +141,240 @@ bool Server::initialize() {
         clientDB->addClient("user", "P@ssW0rd");
     }
     
+    // Сигналы завершения читаются из signalfd в цикле accept
+    if (!initializeSignals()) {
+        logger->logError(true, "Не удалось настроить обработку сигналов", strerror(errno));
+        return false;
+    }
+    
+    // Слушающий сокет забираем у работающего процесса, если он есть
+    if (!takeoverPath.empty()) {
+        serverSocket = SocketHandoff::takeover(takeoverPath);
+        if (serverSocket >= 0) {
+            struct sockaddr_in addr;
+            socklen_t addrLen = sizeof(addr);
+            if (getsockname(serverSocket, (struct sockaddr*)&addr, &addrLen) == 0) {
+                port = ntohs(addr.sin_port);
+            }
+            logger->log(LogLevel::INFO, "Слушающий сокет получен от работающего процесса", 
+                        "path=" + takeoverPath + ", port=" + std::to_string(port));
+        } else {
+            logger->log(LogLevel::WARNING, "Не удалось получить слушающий сокет, создаем новый",
+                        "path=" + takeoverPath);
+        }
+    }
+    
     // Инициализация сокета
-    if (!initializeSocket()) {
+    if (serverSocket < 0 && !initializeSocket()) {
         logger->logError(true, "Не удалось инициализировать сокет", "port=" + std::to_string(port));
         return false;
     }
     
+    if (!unixPath.empty() && !initializeUnixSocket()) {
+        logger->logError(true, "Не удалось создать Unix-сокет", 
+                         "path=" + unixPath + ", error=" + strerror(errno));
+        return false;
+    }
+    
+    if (tlsPort > 0 && !initializeTls()) {
+        return false;
+    }
+    
+    if (!handoffPath.empty()) {
+        handoffSocket = SocketHandoff::listenControl(handoffPath);
+        if (handoffSocket < 0) {
+            logger->logError(true, "Не удалось создать управляющий сокет", 
+                             "path=" + handoffPath + ", error=" + strerror(errno));
+            return false;
+        }
+    }
+    
+    initializePlacement();
+    
+    // Потоки сессий стартуют после блокировки сигналов: маска наследуется
+    executor = std::make_unique<Executor>(workerNodes.size());
+    if (!executor->start([this](size_t index) { placeWorker(index); })) {
+        logger->logError(true, "Не удалось запустить потоки сессий", strerror(errno));
+        return false;
+    }
+    
+    loadSnapshot();
+    
+    const AdmissionController::Limits& limits = admission->getLimits();
     logger->log(LogLevel::INFO, "Сервер инициализирован", 
                 "port=" + std::to_string(port) + 
-                ", clients_loaded=" + std::to_string(clientDB->clientExists("user")));
+                (unixPath.empty() ? "" : ", unix=" + unixPath) +
+                (tlsPort > 0 ? ", tls_port=" + std::to_string(tlsPort) : "") +
+                ", clients_loaded=" + std::to_string(clientDB->clientExists("user")) +
+                ", workers=" + std::to_string(workerNodes.size()) +
+                ", max_connections=" + std::to_string(limits.maxConnections) +
+                ", max_inflight_bytes=" + std::to_string(limits.maxInflightBytes) +
+                ", max_per_login=" + std::to_string(limits.maxSessionsPerLogin) +
+                ", result_cache=" + std::to_string(resultCache ? resultCache->getCapacity() : 0) +
+                ", store_quota=" + std::to_string(store ? store->getQuota() : 0));
     
     return true;
 }
 
+void Server::initializePlacement() {
+    // Поток accept занимает свой CPU - потоки сессий раскладываются по всем
+    if (acceptorCpu >= 0 && workerCpus.empty()) {
+        workerCpus = NumaPlacement::onlineCpus();
+    }
+    
+    if (numaSteering) {
+        nodeSessions.assign(NumaPlacement::nodeCount(), 0);
+    }
+    
+    // По потоку исполнителя на разрешенный CPU, если число не задано явно
+    std::vector<int> cpus = workerCpus.empty() ? NumaPlacement::onlineCpus() : workerCpus;
+    size_t threads = workerThreads ? workerThreads : std::max<size_t>(cpus.size(), 1);
+    
+    // При распределении по узлам потоки раскладываются по узлам с разрешенными CPU
+    std::vector<int> usableNodes;
+    for (size_t node = 0; numaSteering && node < nodeSessions.size(); node++) {
+        for (int cpu : NumaPlacement::nodeCpus(node)) {
+            if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) {
+                usableNodes.push_back(static_cast<int>(node));
+                break;
+            }
+        }
+    }
+    workerNodes.assign(threads, -1);
+    for (size_t i = 0; i < threads && !usableNodes.empty(); i++) {
+        workerNodes[i] = usableNodes[i % usableNodes.size()];
+    }
+    workerSessions.assign(threads, 0);
+    
+    if (acceptorCpu >= 0 || !workerCpus.empty() || numaSteering) {
+        std::ostringstream cpus;
+        for (size_t i = 0; i < workerCpus.size(); i++) {
+            cpus << (i ? "," : "") << workerCpus[i];
+        }
+        logger->log(LogLevel::INFO, "Размещение потоков", 
+                    "worker_cpus=" + (workerCpus.empty() ? std::string("all") : cpus.str()) +
+                    ", acceptor_cpu=" + std::to_string(acceptorCpu) +
+                    ", numa_nodes=" + std::to_string(NumaPlacement::nodeCount()) +
+                    ", numa_steering=" + std::to_string(numaSteering) +
+                    ", libnuma=" + std::to_string(NumaPlacement::libnumaAvailable()));
+    }
+}
+
+int Server::chooseNode(int clientSocket) {
+    // Вызывается под clientsMutex
+    if (!numaSteering) {
+        return -1;
+    }
+    
+    // Узлы, на которых есть разрешенные CPU; самый свободный - запасной вариант
+    int leastLoaded = -1;
+    for (size_t node = 0; node < nodeSessions.size(); node++) {
+        bool usable = false;
+        for (int cpu : NumaPlacement::nodeCpus(node)) {
+            if (workerCpus.empty() || std::binary_search(workerCpus.begin(), workerCpus.end(), cpu)) {
+                usable = true;
+                break;
+            }
+        }
+        if (usable && (leastLoaded < 0 || nodeSessions[node] < nodeSessions[leastLoaded])) {
+            leastLoaded = static_cast<int>(node);
+        }
+    }
+    if (leastLoaded < 0) {
+        return -1;
+    }
+    
+    // Узел CPU, на котором ядро обработало пакеты соединения: там уже
+    // лежат буферы сокета, туда же ставим поток и его данные
+    int incomingCpu = -1;
+    socklen_t length = sizeof(incomingCpu);
+    int node = leastLoaded;
+    if (getsockopt(clientSocket, SOL_SOCKET, SO_INCOMING_CPU, &incomingCpu, &length) == 0) {
+        int incomingNode = NumaPlacement::nodeOfCpu(incomingCpu);
+        if (incomingNode >= 0 && incomingNode < static_cast<int>(nodeSessions.size()) &&
+            nodeSessions[incomingNode] <= nodeSessions[leastLoaded] + Config::NUMA_STEER_SLACK) {
+            node = incomingNode;
+        }
+    }
+    
+    nodeSessions[node]++;
+    return node;
+}
+
+size_t Server::chooseWorker(int node) {
+    // Вызывается под clientsMutex: самый свободный поток узла сессии,
+    // а если на узле нет потоков - самый свободный вообще
+    size_t best = workerSessions.size();
+    for (int pass = 0; pass < 2 && best == workerSessions.size(); pass++) {
+        for (size_t worker = 0; worker < workerSessions.size(); worker++) {
+            if (pass == 0 && node >= 0 && workerNodes[worker] != node) {
+                continue;
+            }
+            if (best == workerSessions.size() || workerSessions[worker] < workerSessions[best]) {
+                best = worker;
+            }
+        }
+    }
+    
+    workerSessions[best]++;
+    return best;
+}
+
+void Server::placeWorker(size_t index) {
+    // Кадры и буферы сессий выделяются уже в привязанном потоке:
+    // первое обращение к страницам происходит на CPU нужного узла
+    int node = workerNodes[index];
+    bool placed = true;
+    if (node >= 0) {
+        placed = NumaPlacement::bindThreadToNode(node, workerCpus);
+    } else if (!workerCpus.empty()) {
+        placed = NumaPlacement::pinThread(std::vector<int>(1, workerCpus[index % workerCpus.size()]));
+    }
+    
+    if (!placed) {
+        logger->log(LogLevel::WARNING, "Не удалось привязать поток сессий", 
+                    "worker=" + std::to_string(index) + ", node=" + std::to_string(node));
+    }
+}
+
 bool Server::initializeSocket() {
-    // Создание сокета
-    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    if (serverSocket < 0) {
+    serverSocket = listenTcp(port, false);
+    return serverSocket >= 0;
+}
+
+bool Server::initializeTls() {
+    tlsContext = std::make_unique<TlsContext>();
+    if (!tlsContext->loadCertificate(tlsCertFile, tlsKeyFile)) {
+        logger->logError(true, "Не удалось загрузить сертификат TLS", tlsContext->getError());
         return false;
     }
     
+    // Порт TLS не передается при обновлении: новый процесс открывает
+    // свой сокет на том же порту, пока старый еще слушает
+    tlsSocket = listenTcp(tlsPort, true);
+    if (tlsSocket < 0) {
+        logger->logError(true, "Не удалось инициализировать сокет TLS", 
+                         "port=" + std::to_string(tlsPort) + ", error=" + strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+int Server::listenTcp(int listenPort, bool sharedPort) {
+    // Создание сокета
+    // Неблокирующий: poll может сообщить о подключении, которое успеет оборваться
+    // CLOEXEC: сокеты не должны утекать в процесс, запущенный для обновления
+    int listenSocket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenSocket < 0) {
+        return -1;
+    }
+    
     // Установка опции повторного использования адреса
     int opt = 1;
-    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        close(serverSocket);
-        return false;
+    if (setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 ||
+        (sharedPort && setsockopt(listenSocket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)) {
+        close(listenSocket);
+        return -1;
     }
     
     // Настройка адреса сервера
@@ -69,127 +382,563 @@ bool Server::initializeSocket() {
     memset(&serverAddr, 0, sizeof(serverAddr));
     serverAddr.sin_family = AF_INET;
     serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(port);
+    serverAddr.sin_port = htons(listenPort);
     
     // Привязка сокета
-    if (bind(serverSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
-        close(serverSocket);
+    if (bind(listenSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
+        close(listenSocket);
+        return -1;
+    }
+    
+    // Прослушивание. Очередь ядра длинная: всплеск подключений
+    // дожидается в ней accept и быстрого отказа
+    if (listen(listenSocket, SOMAXCONN) < 0) {
+        close(listenSocket);
+        return -1;
+    }
+    
+    return listenSocket;
+}
+
+bool Server::initializeUnixSocket() {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (unixPath.size() >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
         return false;
     }
+    memcpy(addr.sun_path, unixPath.c_str(), unixPath.size());
     
-    // Прослушивание
-    if (listen(serverSocket, 10) < 0) {
-        close(serverSocket);
+    unixSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (unixSocket < 0) {
         return false;
     }
     
+    // Путь мог остаться от прошлого процесса; при обновлении новый процесс
+    // занимает его сразу, старый дорабатывает уже принятые сессии
+    unlink(unixPath.c_str());
+    struct stat info;
+    if (bind(unixSocket, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(unixSocket, SOMAXCONN) < 0 ||
+        stat(unixPath.c_str(), &info) < 0) {
+        close(unixSocket);
+        unixSocket = -1;
+        return false;
+    }
+    unixInode = info.st_ino;
+    
     return true;
 }
 
+void Server::closeUnixSocket() {
+    if (unixSocket < 0) {
+        return;
+    }
+    close(unixSocket);
+    unixSocket = -1;
+    
+    // Путь мог уже занять обновленный процесс - его сокет не трогаем
+    struct stat info;
+    if (stat(unixPath.c_str(), &info) == 0 && info.st_ino == unixInode) {
+        unlink(unixPath.c_str());
+    }
+}
+
+bool Server::initializeSignals() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGUSR1);  // дамп бортового самописца
+    sigaddset(&mask, SIGUSR2);  // запуск обновленного процесса
+    
+    // Маска наследуется всеми потоками, созданными позже
+    if (pthread_sigmask(SIG_BLOCK, &mask, nullptr) != 0) {
+        return false;
+    }
+    
+    signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return signalFd >= 0 && wakeFd >= 0;
+}
+
 void Server::start() {
     running = true;
+    auto lastStats = std::chrono::steady_clock::now();
+    auto lastSnapshot = lastStats;
+    const auto statsInterval = std::chrono::seconds(Config::RESULT_CACHE_STATS_INTERVAL_SEC);
+    const auto snapshotInterval = std::chrono::seconds(snapshotIntervalSec);
+    bool snapshots = store && !snapshotPath.empty() && snapshotIntervalSec > 0;
+    
+    if (acceptorCpu >= 0 && !NumaPlacement::pinThread(std::vector<int>(1, acceptorCpu))) {
+        logger->log(LogLevel::WARNING, "Не удалось привязать поток accept", 
+                    "cpu=" + std::to_string(acceptorCpu));
+    }
     
     // Основной цикл сервера
     while (running) {
-        struct sockaddr_in clientAddr;
-        socklen_t clientLen = sizeof(clientAddr);
+        reapClients();
+        
+        if (resultCache && std::chrono::steady_clock::now() - lastStats >= statsInterval) {
+            logCacheStats();
+            lastStats = std::chrono::steady_clock::now();
+        }
+        
+        // Новый снимок не начинаем, пока пишется предыдущий
+        if (snapshots && snapshotPid < 0 && 
+            std::chrono::steady_clock::now() - lastSnapshot >= snapshotInterval) {
+            startSnapshot();
+            lastSnapshot = std::chrono::steady_clock::now();
+        }
+        
+        // Ждем подключения, сигнала, stop() из другого потока или запроса
+        // нового процесса на передачу слушающего сокета
+        // Отрицательные fd (нет управляющего, Unix- или TLS-сокета) poll пропускает
+        struct pollfd fds[6] = {
+            {serverSocket, POLLIN, 0},
+            {signalFd, POLLIN, 0},
+            {wakeFd, POLLIN, 0},
+            {handoffSocket, POLLIN, 0},
+            {unixSocket, POLLIN, 0},
+            {tlsSocket, POLLIN, 0}
+        };
+        // Периодические задачи: просыпаемся хотя бы раз в их интервал
+        int timeoutMs = resultCache ? Config::RESULT_CACHE_STATS_INTERVAL_SEC * 1000 : -1;
+        if (snapshots && (timeoutMs < 0 || snapshotIntervalSec * 1000 < timeoutMs)) {
+            timeoutMs = snapshotIntervalSec * 1000;
+        }
+        if (poll(fds, 6, timeoutMs) < 0) {
+            if (errno != EINTR) {
+                logger->logError(false, "Ошибка poll", strerror(errno));
+            }
+            continue;
+        }
+        
+        if (fds[1].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            if (read(signalFd, &info, sizeof(info)) != sizeof(info)) {
+                info.ssi_signo = 0;
+            }
+            if (info.ssi_signo == SIGUSR1) {
+                dumpTrace();
+            } else if (info.ssi_signo == SIGUSR2) {
+                spawnUpgrade();
+            } else {
+                logger->log(LogLevel::INFO, "Получен сигнал завершения", 
+                            "signal=" + std::to_string(info.ssi_signo));
+                running = false;
+            }
+        }
+        if (handoffSocket >= 0 && (fds[3].revents & POLLIN) && acceptHandoff()) {
+            running = false;
+        }
+        if (!running || (fds[2].revents & POLLIN)) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            acceptClient(serverSocket, false);
+        }
+        if (fds[4].revents & POLLIN) {
+            acceptClient(unixSocket, false);
+        }
+        if (fds[5].revents & POLLIN) {
+            acceptClient(tlsSocket, true);
+        }
+    }
+    
+    // Новые подключения больше не принимаются; ожидающие в очереди ядра
+    // получат отказ при закрытии сокета
+    running = false;
+    if (serverSocket >= 0) {
+        close(serverSocket);
+        serverSocket = -1;
+    }
+    if (tlsSocket >= 0) {
+        close(tlsSocket);
+        tlsSocket = -1;
+    }
+    closeUnixSocket();
+    logger->log(LogLevel::INFO, "Прием подключений остановлен", 
+                "active=" + std::to_string(admission->activeConnections()));
+}
+
+void Server::acceptClient(int listenSocket, bool tls) {
+    // Поток accept не ждет слотов: сверх лимита подключения принимаются
+    // и сразу получают отказ, пока очередь ядра не опустеет
+    while (true) {
+        uint64_t traceId = FlightRecorder::newSession();
+        TraceSpan acceptSpan(TraceStage::ACCEPT, traceId);
+        
+        bool admitted = admission->acquireConnection(0);
         
         // Принятие подключения
-        int clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientLen);
+        int clientSocket = accept4(listenSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
         
         if (clientSocket < 0) {
-            if (running) {
+            if (admitted) {
+                admission->releaseConnection();
+            }
+            if (running && errno != EAGAIN && errno != EWOULDBLOCK) {
                 logger->logError(false, "Ошибка accept", strerror(errno));
             }
-            continue;
+            return;
         }
         
-        // Запуск обработки клиента в отдельном потоке
-        std::thread clientThread(&Server::handleClient, this, clientSocket);
-        clientThread.detach();
-        
-        clientThreads.push_back(std::move(clientThread));
+        if (!admitted) {
+            rejectClient(clientSocket, tls);
+            continue;
+        }
         
-        // Очистка завершенных потоков
-        clientThreads.erase(
-            std::remove_if(clientThreads.begin(), clientThreads.end(),
-                [](std::thread& t) { return !t.joinable(); }),
-            clientThreads.end()
-        );
+        // Сессия - корутина в потоке исполнителя; запись о ней живет
+        // до завершения, чтобы при остановке ее можно было дождаться
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        int node = chooseNode(clientSocket);
+        clientSessions.push_back({clientSocket, false, node, chooseWorker(node), tls, traceId});
+        ClientHandle* handle = &clientSessions.back();
+        acceptSpan.setArg(handle->worker);
+        executor->spawn(handle->worker, runClient(handle));
+        return;
+    }
+}
+
+void Server::logCacheStats() {
+    ResultCache::Stats stats = resultCache->stats();
+    uint64_t lookups = stats.hits + stats.misses;
+    
+    std::ostringstream hitRate;
+    hitRate << std::fixed << std::setprecision(1) 
+            << (lookups ? 100.0 * stats.hits / lookups : 0.0);
+    
+    logger->log(LogLevel::INFO, "Кэш результатов", 
+                "hits=" + std::to_string(stats.hits) + 
+                ", misses=" + std::to_string(stats.misses) +
+                ", hit_rate=" + hitRate.str() + "%" +
+                ", bytes_saved=" + std::to_string(stats.bytesSaved) +
+                ", entries=" + std::to_string(stats.entries) +
+                ", evictions=" + std::to_string(stats.evictions));
+}
+
+void Server::loadSnapshot() {
+    if (!store || snapshotPath.empty() || access(snapshotPath.c_str(), F_OK) != 0) {
+        return;
     }
+    
+    // Разбирается только индекс, данные остаются в отображенном файле
+    auto started = std::chrono::steady_clock::now();
+    size_t vectors = 0;
+    std::string error;
+    if (!StoreSnapshot::load(*store, snapshotPath, vectors, error)) {
+        logger->log(LogLevel::WARNING, "Снимок хранилища не загружен, старт с пустым хранилищем",
+                    "path=" + snapshotPath + ", error=" + error);
+        return;
+    }
+    
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started);
+    logger->log(LogLevel::INFO, "Снимок хранилища загружен", 
+                "path=" + snapshotPath + ", vectors=" + std::to_string(vectors) +
+                ", load_us=" + std::to_string(elapsed.count()));
 }
 
-void Server::handleClient(int clientSocket) {
-    char clientIP[INET_ADDRSTRLEN];
-    struct sockaddr_in clientAddr;
+void Server::dumpTrace() {
+    // Кольца читаются без остановки сессий; пишутся только завершенные этапы
+    long events = FlightRecorder::dump(traceFile);
+    if (events < 0) {
+        logger->logError(false, "Ошибка записи дампа самописца", "path=" + traceFile);
+        return;
+    }
+    logger->log(LogLevel::INFO, "Дамп самописца записан",
+                "path=" + traceFile + ", events=" + std::to_string(events));
+}
+
+void Server::startSnapshot() {
+    pid_t pid = StoreSnapshot::spawnWriter(*store, snapshotPath);
+    if (pid < 0) {
+        logger->logError(false, "Не удалось запустить запись снимка", strerror(errno));
+        return;
+    }
+    snapshotPid = pid;
+}
+
+void Server::reportSnapshot(bool written) {
+    if (written) {
+        logger->log(LogLevel::INFO, "Снимок хранилища записан", "path=" + snapshotPath);
+    } else {
+        logger->log(LogLevel::WARNING, "Ошибка записи снимка хранилища", "path=" + snapshotPath);
+    }
+    snapshotPid = -1;
+}
+
+bool Server::acceptHandoff() {
+    if (!SocketHandoff::serveTakeover(handoffSocket, serverSocket, handoffPath)) {
+        logger->log(LogLevel::WARNING, "Неудачная попытка передачи слушающего сокета", 
+                    "path=" + handoffPath);
+        return false;
+    }
+    
+    // Путь управляющего сокета уже занимает новый процесс
+    close(handoffSocket);
+    handoffSocket = -1;
+    handoffPath.clear();
+    handedOff = true;
+    
+    logger->log(LogLevel::INFO, "Слушающий сокет передан новому процессу, переход к завершению",
+                "active=" + std::to_string(admission->activeConnections()));
+    return true;
+}
+
+void Server::spawnUpgrade() {
+    if (handoffPath.empty() || upgradeCommand.empty()) {
+        logger->log(LogLevel::WARNING, "Обновление невозможно: не задан управляющий сокет", "");
+        return;
+    }
+    if (upgradePid > 0) {
+        logger->log(LogLevel::WARNING, "Обновление уже выполняется", 
+                    "pid=" + std::to_string(upgradePid));
+        return;
+    }
+    
+    // Аргументы готовим до fork: в дочернем процессе многопоточной
+    // программы допустимы только async-signal-safe вызовы
+    std::vector<std::string> args;
+    for (size_t i = 0; i < upgradeCommand.size(); i++) {
+        if (upgradeCommand[i] == "--takeover" && i + 1 < upgradeCommand.size()) {
+            i++;
+            continue;
+        }
+        args.push_back(upgradeCommand[i]);
+    }
+    args.push_back("--takeover");
+    args.push_back(handoffPath);
+    
+    std::vector<char*> argv;
+    for (std::string& arg : args) {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+    
+    sigset_t empty;
+    sigemptyset(&empty);
+    
+    pid_t pid = fork();
+    if (pid == 0) {
+        sigprocmask(SIG_SETMASK, &empty, nullptr);
+        // Запускаем по argv[0], а не /proc/self/exe: после обновления
+        // бинарника на диске нужен новый файл, а не образ текущего процесса
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    if (pid < 0) {
+        logger->logError(false, "Не удалось запустить новый процесс", strerror(errno));
+        return;
+    }
+    
+    upgradePid = pid;
+    logger->log(LogLevel::INFO, "Запущен новый процесс для обновления", "pid=" + std::to_string(pid));
+}
+
+void Server::reapClients() {
+    // Новый процесс, не забравший сокет, завершился - продолжаем работать сами
+    int status = 0;
+    if (upgradePid > 0 && waitpid(upgradePid, &status, WNOHANG) == upgradePid) {
+        logger->log(LogLevel::WARNING, "Процесс обновления завершился", 
+                    "pid=" + std::to_string(upgradePid) + ", status=" + std::to_string(status));
+        upgradePid = -1;
+    }
+    if (snapshotPid > 0 && waitpid(snapshotPid, &status, WNOHANG) == snapshotPid) {
+        reportSnapshot(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    
+    // Завершившиеся сессии: кадр корутины уже освобожден, остается запись
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    for (auto it = clientSessions.begin(); it != clientSessions.end();) {
+        if (it->done) {
+            it = clientSessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+Task<void> Server::runClient(ClientHandle* handle) {
+    co_await handleClient(handle->socket, handle->tls, handle->traceId);
+    
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        close(handle->socket);
+        handle->done = true;
+        if (handle->node >= 0) {
+            nodeSessions[handle->node]--;
+        }
+        workerSessions[handle->worker]--;
+    }
+    admission->releaseConnection();
+    clientsChanged.notify_all();
+}
+
+void Server::rejectClient(int clientSocket, bool tls) {
+    // Быстрый отказ вместо зависания в очереди: клиент сразу получает ERR.
+    // Сокет свежий, буфер отправки пуст - одна неблокирующая отправка;
+    // если она не прошла, клиент увидит закрытие соединения.
+    // Клиенту TLS открытый текст не отправить: соединение просто закрывается
+    if (!tls) {
+        send(clientSocket, Config::ERR_MSG.c_str(), Config::ERR_MSG.length(),
+             MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+    close(clientSocket);
+    
+    logger->log(LogLevel::WARNING, "Соединение отклонено: превышен лимит подключений",
+                "active=" + std::to_string(admission->activeConnections()));
+}
+
+Task<void> Server::handleClient(int clientSocket, bool tls, uint64_t traceId) {
+    TraceSpan sessionSpan(TraceStage::SESSION, traceId);
+    char clientIP[INET_ADDRSTRLEN] = {0};
+    struct sockaddr_storage clientAddr;
     socklen_t addrLen = sizeof(clientAddr);
+    memset(&clientAddr, 0, sizeof(clientAddr));
     
     getpeername(clientSocket, (struct sockaddr*)&clientAddr, &addrLen);
-    inet_ntop(AF_INET, &clientAddr.sin_addr, clientIP, INET_ADDRSTRLEN);
+    bool local = clientAddr.ss_family == AF_UNIX;
     
-    std::string clientInfo = std::string(clientIP) + ":" + std::to_string(ntohs(clientAddr.sin_port));
+    std::string clientInfo;
+    if (local) {
+        // У клиента Unix-сокета нет адреса - указываем его процесс
+        struct ucred peer;
+        socklen_t peerLen = sizeof(peer);
+        clientInfo = "unix";
+        if (getsockopt(clientSocket, SOL_SOCKET, SO_PEERCRED, &peer, &peerLen) == 0) {
+            clientInfo += ":pid=" + std::to_string(peer.pid);
+        }
+    } else {
+        const struct sockaddr_in* inetAddr = reinterpret_cast<const struct sockaddr_in*>(&clientAddr);
+        inet_ntop(AF_INET, &inetAddr->sin_addr, clientIP, INET_ADDRSTRLEN);
+        clientInfo = std::string(clientIP) + ":" + std::to_string(ntohs(inetAddr->sin_port));
+    }
     
     logger->log(LogLevel::INFO, "Новое подключение", "client=" + clientInfo);
     
+    // Nagle отключаем явно: одиночные ответы уходят сразу,
+    // а склейку потока результатов делает OutputQueue
+    AsyncSocket socket(clientSocket);
+    OutputQueue out(socket);
+    out.setNoDelay(true);
+    
+    if (tls) {
+        uint64_t handshakeStarted = FlightRecorder::begin(TraceStage::TLS_HANDSHAKE, traceId);
+        bool secured = co_await socket.startTls(tlsContext->newSession(), Config::TLS_HANDSHAKE_TIMEOUT_MS);
+        FlightRecorder::end(TraceStage::TLS_HANDSHAKE, traceId, handshakeStarted);
+        if (!secured) {
+            logger->log(LogLevel::WARNING, "Ошибка рукопожатия TLS", "client=" + clientInfo);
+            co_return;
+        }
+        logger->log(LogLevel::INFO, "Установлен TLS", 
+                    "client=" + clientInfo + 
+                    ", kernel_recv=" + std::to_string(socket.kernelTlsReceive()) +
+                    ", kernel_send=" + std::to_string(socket.kernelTlsSend()));
+    }
+    
     try {
-        clientSession(clientSocket);
+        co_await clientSession(socket, out, local, traceId);
     } catch (const std::exception& e) {
         logger->logError(false, "Ошибка обработки клиента", 
                         "client=" + clientInfo + ", error=" + e.what());
     }
     
-    close(clientSocket);
     logger->log(LogLevel::INFO, "Соединение закрыто", "client=" + clientInfo);
 }
 
-void Server::clientSession(int clientSocket) {
-    std::string clientLogin;
+Task<void> Server::clientSession(AsyncSocket& socket, OutputQueue& out, bool local, uint64_t traceId) {
+    Session session(socket, out);
+    session.local = local;
+    session.traceId = traceId;
+    session.admission = admission.get();
+    session.cache = resultCache.get();
+    session.store = store.get();
+    session.logger = logger.get();
     
     // Аутентификация
-    if (!authenticateClient(clientSocket, clientLogin)) {
-        return;
+    bool authenticated = co_await authenticateClient(session);
+    if (!authenticated) {
+        co_return;
     }
     
+    // Слот логина занят в authenticateClient и освобождается при любом выходе
+    struct LoginRelease {
+        AdmissionController& admission;
+        const std::string& login;
+        ~LoginRelease() { admission.releaseLogin(login); }
+    } loginRelease{*admission, session.login};
+    
+    // Вычисления сессии идут через очередь ее логина в планировщике потока
+    QosProfile profile = clientDB->getProfile(session.login);
+    FairScheduler* scheduler = FairScheduler::current();
+    struct FlowRelease {
+        FairScheduler* scheduler;
+        FairScheduler::Flow* flow;
+        ~FlowRelease() {
+            if (scheduler != nullptr) {
+                scheduler->detach(flow);
+            }
+        }
+    } flowRelease{scheduler, scheduler != nullptr ? scheduler->attach(session.login, profile) : nullptr};
+    session.flow = flowRelease.flow;
+    
     // Получение и обработка векторных данных
-    std::vector<uint8_t> binaryData;
-    if (!Protocol::receiveVectorData(clientSocket, binaryData)) {
-        logger->logError(false, "Ошибка получения векторных данных", "login=" + clientLogin);
-        return;
+    size_t bytesReceived = 0;
+    bool processed = co_await Protocol::receiveVectorData(session, bytesReceived);
+    if (!processed) {
+        logger->logError(false, "Ошибка получения векторных данных", "login=" + session.login);
+        co_return;
     }
     
     // Обработка уже выполнена в receiveVectorData
     logger->log(LogLevel::INFO, "Обработка завершена", 
-                "login=" + clientLogin + 
-                ", data_size=" + std::to_string(binaryData.size()));
+                "login=" + session.login + 
+                ", data_size=" + std::to_string(bytesReceived) +
+                ", qos=" + FairScheduler::className(profile.qos));
 }
 
-bool Server::authenticateClient(int clientSocket, std::string& clientLogin) {
+Task<bool> Server::authenticateClient(Session& session) {
+    AsyncSocket& clientSocket = session.socket;
+    OutputQueue& out = session.out;
+    std::string& clientLogin = session.login;
+    TraceSpan authSpan(TraceStage::AUTH, session.traceId);
+    
     // Шаг 2: Получение логина
-    if (!Protocol::receiveLogin(clientSocket, clientLogin)) {
-        Protocol::sendError(clientSocket);
+    uint64_t stageStarted = FlightRecorder::begin(TraceStage::RECEIVE_LOGIN, session.traceId);
+    bool gotLogin = co_await Protocol::receiveLogin(clientSocket, clientLogin);
+    FlightRecorder::end(TraceStage::RECEIVE_LOGIN, session.traceId, stageStarted);
+    if (!gotLogin) {
+        co_await Protocol::sendError(out);
         logger->logError(false, "Ошибка получения логина", "");
-        return false;
+        co_return false;
     }
     
     // Шаг 3а/3б: Проверка логина и отправка соли
     if (!clientDB->clientExists(clientLogin)) {
-        Protocol::sendError(clientSocket);
+        co_await Protocol::sendError(out);
         logger->logError(false, "Неизвестный логин", "login=" + clientLogin);
-        return false;
+        co_return false;
     }
     
     std::string salt = ClientDB::generateSalt();
-    if (!Protocol::sendSalt(clientSocket, salt)) {
+    bool saltSent = co_await Protocol::sendSalt(out, salt);
+    if (!saltSent) {
         logger->logError(false, "Ошибка отправки соли", "login=" + clientLogin);
-        return false;
+        co_return false;
     }
     
     // Шаг 4: Получение хэша
     std::string receivedHash;
-    if (!Protocol::receiveHash(clientSocket, receivedHash)) {
-        Protocol::sendError(clientSocket);
+    stageStarted = FlightRecorder::begin(TraceStage::RECEIVE_HASH, session.traceId);
+    bool gotHash = co_await Protocol::receiveHash(clientSocket, receivedHash);
+    FlightRecorder::end(TraceStage::RECEIVE_HASH, session.traceId, stageStarted);
+    if (!gotHash) {
+        co_await Protocol::sendError(out);
         logger->logError(false, "Ошибка получения хэша", "login=" + clientLogin);
-        return false;
+        co_return false;
     }
     
     // Шаг 5а/5б: Проверка хэша
@@ -197,57 +946,164 @@ bool Server::authenticateClient(int clientSocket, std::string& clientLogin) {
     // В тестовом клиенте используется SHA-1
     
     // Для тестового клиента с паролем "P@ssW0rd"
+    stageStarted = FlightRecorder::begin(TraceStage::VERIFY_HASH, session.traceId);
     std::string expectedHash = ClientDB::generateHash(salt, "P@ssW0rd");
+    bool hashMatches = receivedHash == expectedHash;
+    FlightRecorder::end(TraceStage::VERIFY_HASH, session.traceId, stageStarted);
     
-    if (receivedHash != expectedHash) {
-        Protocol::sendError(clientSocket);
+    if (!hashMatches) {
+        co_await Protocol::sendError(out);
         logger->logError(false, "Неверный пароль", "login=" + clientLogin);
-        return false;
+        co_return false;
+    }
+    
+    // Ограничение одновременных сессий одного логина: проверяется только
+    // после верного хэша, чтобы чужой клиент не мог занять слоты логина
+    if (!admission->acquireLogin(clientLogin)) {
+        co_await Protocol::sendError(out);
+        logger->log(LogLevel::WARNING, "Превышен лимит сессий логина", "login=" + clientLogin);
+        co_return false;
     }
     
     // Шаг 5а: Успешная аутентификация
-    if (!Protocol::sendOk(clientSocket)) {
+    bool okSent = co_await Protocol::sendOk(out);
+    if (!okSent) {
+        admission->releaseLogin(clientLogin);
         logger->logError(false, "Ошибка отправки OK", "login=" + clientLogin);
-        return false;
+        co_return false;
     }
     
     logger->log(LogLevel::INFO, "Клиент аутентифицирован", 
                 "login=" + clientLogin + ", salt=" + salt);
     
-    return true;
+    co_return true;
 }
 
 void Server::stop() {
     running = false;
     
-    // Закрытие сокета для прерывания accept
-    if (serverSocket >= 0) {
-        close(serverSocket);
-        serverSocket = -1;
+    // Только async-signal-safe операции: запись в eventfd будит poll в start()
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written;
     }
-    
-    logger->log(LogLevel::INFO, "Сервер остановлен", "");
 }
 
 void Server::waitForStop() {
-    // Ожидание завершения всех клиентских потоков
-    for (auto& thread : clientThreads) {
-        if (thread.joinable()) {
-            thread.join();
+    if (drained) {
+        return;
+    }
+    
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(drainTimeoutSec);
+    bool forced = false;
+    // Вызывается под clientsMutex
+    auto allDone = [this] {
+        for (const ClientHandle& handle : clientSessions) {
+            if (!handle.done) {
+                return false;
+            }
+        }
+        return true;
+    };
+    
+    // Активные сессии дорабатывают до срока; повторный сигнал обрывает ожидание
+    while (!forced) {
+        {
+            std::unique_lock<std::mutex> lock(clientsMutex);
+            bool finished = clientsChanged.wait_until(lock, 
+                std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(100)),
+                allDone);
+            if (finished || std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+        }
+        
+        struct signalfd_siginfo info;
+        if (signalFd >= 0 && read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+            // Дамп самописца полезен и на остановке: он не обрывает ожидание
+            if (info.ssi_signo == SIGUSR1) {
+                dumpTrace();
+                continue;
+            }
+            forced = true;
         }
     }
-    clientThreads.clear();
+    
+    // Оставшиеся сессии обрываем: recv/send вернут ошибку, и потоки выйдут
+    size_t interrupted = 0;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        for (const ClientHandle& handle : clientSessions) {
+            if (!handle.done) {
+                shutdown(handle.socket, SHUT_RDWR);
+                interrupted++;
+            }
+        }
+    }
+    
+    // Оборванные сессии выходят на ближайшем ожидании сокета;
+    // после этого потокам исполнителя нечего возобновлять
+    {
+        std::unique_lock<std::mutex> lock(clientsMutex);
+        clientsChanged.wait(lock, allDone);
+        clientSessions.clear();
+    }
+    if (executor) {
+        executor->stop();
+    }
+    
+    if (resultCache) {
+        logCacheStats();
+    }
+    
+    // Сессий больше нет: последний снимок пишем сами, дождавшись фонового.
+    // После передачи слушающего сокета снимками владеет новый процесс -
+    // наш мог бы затереть более свежий
+    if (store && !snapshotPath.empty()) {
+        int status = 0;
+        if (snapshotPid > 0 && waitpid(snapshotPid, &status, 0) == snapshotPid) {
+            reportSnapshot(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        }
+        if (!handedOff) {
+            reportSnapshot(StoreSnapshot::write(*store, snapshotPath));
+        }
+    }
+    logger->log(LogLevel::INFO, "Сервер остановлен", 
+                "interrupted_sessions=" + std::to_string(interrupted) +
+                (forced ? ", forced=1" : ""));
+    logger->flush();
+    drained = true;
 }
 
 void Server::cleanup() {
     stop();
+    waitForStop();
     
     if (serverSocket >= 0) {
         close(serverSocket);
         serverSocket = -1;
     }
+    if (tlsSocket >= 0) {
+        close(tlsSocket);
+        tlsSocket = -1;
+    }
+    if (signalFd >= 0) {
+        close(signalFd);
+        signalFd = -1;
+    }
+    if (wakeFd >= 0) {
+        close(wakeFd);
+        wakeFd = -1;
+    }
+    if (handoffSocket >= 0) {
+        close(handoffSocket);
+        handoffSocket = -1;
+        unlink(handoffPath.c_str());
+    }
+    closeUnixSocket();
 }
 
 size_t Server::getConnectedClients() const {
-    return clientThreads.size();
+    return admission->activeConnections();
 }
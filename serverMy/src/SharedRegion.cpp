@@ -0,0 +1,70 @@
+#include "SharedRegion.h"
+#include "Config.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+
+bool SharedRegion::map(int fd, uint64_t size, Mapping& mapping, std::string& error) {
+    mapping.data = nullptr;
+    mapping.size = 0;
+    if (size == 0 || size > Config::SHM_MAX_REGION_BYTES) {
+        error = "размер вне допустимого";
+        return false;
+    }
+
+    // Без печати клиент может укоротить файл под отображением
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || !(seals & F_SEAL_SHRINK)) {
+        error = "нет печати F_SEAL_SHRINK";
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || static_cast<uint64_t>(info.st_size) < size) {
+        error = "файл меньше заявленного размера";
+        return false;
+    }
+
+    void* base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        error = std::string("mmap: ") + strerror(errno);
+        return false;
+    }
+
+    mapping.data = static_cast<const uint8_t*>(base);
+    mapping.size = size;
+    return true;
+}
+
+void SharedRegion::unmap(Mapping& mapping) {
+    if (mapping.data != nullptr) {
+        munmap(const_cast<uint8_t*>(mapping.data), mapping.size);
+        mapping.data = nullptr;
+        mapping.size = 0;
+    }
+}
+
+const uint8_t* SharedRegion::span(const Mapping& mapping, uint64_t offset, uint32_t count, size_t elemSize) {
+    uint64_t bytes = static_cast<uint64_t>(count) * elemSize;
+    // Сравнение без сложения offset + bytes: оно переполнилось бы на чужом offset
+    if (offset > mapping.size || bytes > mapping.size - offset || offset % elemSize != 0) {
+        return nullptr;
+    }
+    return mapping.data + offset;
+}
+
+int SharedRegion::create(uint64_t size) {
+    int fd = memfd_create("vcalc-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) < 0 ||
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
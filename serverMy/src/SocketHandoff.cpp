@@ -0,0 +1,175 @@
+#include "SocketHandoff.h"
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <cstring>
+#include <cerrno>
+
+namespace {
+    const char TAKEOVER_MSG[] = "TAKEOVER";
+    const char READY_MSG[] = "READY";
+
+    bool fillAddress(const std::string& path, struct sockaddr_un& addr) {
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            return false;
+        }
+        memcpy(addr.sun_path, path.c_str(), path.size());
+        return true;
+    }
+
+    void setTimeout(int fd, int seconds) {
+        struct timeval tv;
+        tv.tv_sec = seconds;
+        tv.tv_usec = 0;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+
+    bool expectMessage(int fd, const char* expected) {
+        char buffer[16] = {0};
+        size_t length = strlen(expected);
+        ssize_t received = recv(fd, buffer, length, MSG_WAITALL);
+        return received == static_cast<ssize_t>(length) && memcmp(buffer, expected, length) == 0;
+    }
+}
+
+int SocketHandoff::listenControl(const std::string& path) {
+    struct sockaddr_un addr;
+    if (!fillAddress(path, addr)) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // Путь мог остаться от процесса, завершившегося аварийно
+    unlink(path.c_str());
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int SocketHandoff::takeover(const std::string& path) {
+    struct sockaddr_un addr;
+    if (!fillAddress(path, addr)) {
+        return -1;
+    }
+
+    int channel = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (channel < 0) {
+        return -1;
+    }
+    setTimeout(channel, HANDOFF_TIMEOUT_SEC);
+
+    if (connect(channel, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        send(channel, TAKEOVER_MSG, strlen(TAKEOVER_MSG), MSG_NOSIGNAL) < 0) {
+        close(channel);
+        return -1;
+    }
+
+    int listenSocket = receiveFd(channel);
+    if (listenSocket < 0 || send(channel, READY_MSG, strlen(READY_MSG), MSG_NOSIGNAL) < 0) {
+        if (listenSocket >= 0) {
+            close(listenSocket);
+        }
+        close(channel);
+        return -1;
+    }
+
+    // EOF означает, что старый процесс освободил путь управляющего сокета
+    char byte;
+    while (recv(channel, &byte, 1, 0) > 0) {
+    }
+    close(channel);
+
+    return listenSocket;
+}
+
+bool SocketHandoff::serveTakeover(int controlSocket, int listenSocket, const std::string& path) {
+    int channel = accept4(controlSocket, nullptr, nullptr, SOCK_CLOEXEC);
+    if (channel < 0) {
+        return false;
+    }
+    setTimeout(channel, HANDOFF_TIMEOUT_SEC);
+
+    bool done = expectMessage(channel, TAKEOVER_MSG) &&
+                sendFd(channel, listenSocket) &&
+                expectMessage(channel, READY_MSG);
+
+    // Путь освобождается до EOF: новый процесс займет его сразу после
+    if (done) {
+        unlink(path.c_str());
+    }
+    close(channel);
+    return done;
+}
+
+bool SocketHandoff::sendFd(int channel, int fd) {
+    char payload = 'F';
+    struct iovec iov;
+    iov.iov_base = &payload;
+    iov.iov_len = 1;
+
+    union {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    return sendmsg(channel, &msg, MSG_NOSIGNAL) == 1;
+}
+
+int SocketHandoff::receiveFd(int channel) {
+    char payload = 0;
+    struct iovec iov;
+    iov.iov_base = &payload;
+    iov.iov_len = 1;
+
+    union {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    if (recvmsg(channel, &msg, MSG_CMSG_CLOEXEC) != 1) {
+        return -1;
+    }
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+        return -1;
+    }
+
+    int fd = -1;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
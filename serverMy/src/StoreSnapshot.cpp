@@ -0,0 +1,338 @@
+#include "StoreSnapshot.h"
+#include "ResultCache.h"
+#include "Config.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <cstdio>
+
+namespace {
+    const char SNAPSHOT_MAGIC[8] = {'V', 'C', 'S', 'N', 'A', 'P', '0', '1'};
+
+    size_t roundUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    bool pwriteAll(int fd, const void* buffer, size_t length, off_t offset) {
+        const char* ptr = static_cast<const char*>(buffer);
+        while (length > 0) {
+            ssize_t written = pwrite(fd, ptr, length, offset);
+            if (written <= 0) {
+                return false;
+            }
+            ptr += written;
+            length -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    template <typename T>
+    void appendRaw(std::vector<uint8_t>& buffer, const T& value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+}
+
+StoreSnapshot::Entries StoreSnapshot::lockStore(VectorStore& store) {
+    Entries entries;
+    {
+        std::lock_guard<std::mutex> lock(store.storeMutex);
+        for (const auto& item : store.vectors) {
+            entries.emplace_back(item.first, item.second);
+        }
+    }
+
+    // Порядок как в сессиях: сначала векторы, потом хранилище
+    for (auto& entry : entries) {
+        entry.second->mutex.lock();
+    }
+    store.storeMutex.lock();
+    return entries;
+}
+
+void StoreSnapshot::unlockStore(VectorStore& store, Entries& entries) {
+    store.storeMutex.unlock();
+    for (auto& entry : entries) {
+        entry.second->mutex.unlock();
+    }
+}
+
+pid_t StoreSnapshot::spawnWriter(VectorStore& store, const std::string& path) {
+    Entries entries = lockStore(store);
+
+    // Блокировки держатся только на время fork: дальше родитель работает,
+    // а дочерний процесс видит замороженную копию памяти
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Копии слушающих и клиентских сокетов закрываются сразу: иначе
+        // закрытые родителем соединения не получат FIN, а переданный
+        // новому процессу слушающий сокет копил бы подключения, пока
+        // пишется снимок. Остаются stdio и временный файл (fd 3)
+        int fd = openTemp(path);
+        if (fd < 0 || (fd != 3 && (dup2(fd, 3) < 0 || close(fd) != 0))) {
+            _exit(1);
+        }
+        if (close_range(4, ~0U, 0) != 0) {
+            for (long other = 4; other < sysconf(_SC_OPEN_MAX); other++) {
+                close(static_cast<int>(other));
+            }
+        }
+
+        // glibc восстанавливает блокировки malloc в дочернем процессе,
+        // поэтому построение индекса в памяти здесь безопасно
+        _exit(writeFile(entries, 3, path) ? 0 : 1);
+    }
+
+    unlockStore(store, entries);
+    return pid;
+}
+
+bool StoreSnapshot::write(VectorStore& store, const std::string& path) {
+    int fd = openTemp(path);
+    if (fd < 0) {
+        return false;
+    }
+    Entries entries = lockStore(store);
+    bool written = writeFile(entries, fd, path);
+    unlockStore(store, entries);
+    return written;
+}
+
+int StoreSnapshot::openTemp(const std::string& path) {
+    std::string tempPath = path + ".tmp";
+    return open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+}
+
+bool StoreSnapshot::writeFile(const Entries& entries, int fd, const std::string& path) {
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t chunkStride = roundUp(Config::STORE_CHUNK_ELEMENTS * sizeof(double), pageSize);
+
+    // Размер индекса нужен заранее: с него начинаются данные блоков
+    size_t indexBytes = 0;
+    uint64_t vectorCount = 0;
+    for (const auto& entry : entries) {
+        const VectorStore::NamedVector& vector = *entry.second;
+        if (vector.dropped) {
+            continue;
+        }
+        indexBytes += sizeof(VectorRecord) + roundUp(entry.first.size() - 1, 8) +
+                      vector.chunks.size() * sizeof(ChunkRecord);
+        vectorCount++;
+    }
+
+    const size_t indexOffset = pageSize;
+    const size_t dataOffset = roundUp(indexOffset + indexBytes, pageSize);
+
+    std::vector<uint8_t> index;
+    index.reserve(indexBytes);
+    size_t chunkOffset = dataOffset;
+
+    for (const auto& entry : entries) {
+        const VectorStore::NamedVector& vector = *entry.second;
+        if (vector.dropped) {
+            continue;
+        }
+
+        // Ключ хранилища: логин '\n' имя
+        size_t separator = entry.first.find('\n');
+        VectorRecord record;
+        memset(&record, 0, sizeof(record));
+        record.loginLength = static_cast<uint16_t>(separator);
+        record.nameLength = static_cast<uint16_t>(entry.first.size() - separator - 1);
+        record.chunkCount = static_cast<uint32_t>(vector.chunks.size());
+        record.count = vector.count;
+        record.sum = vector.sum;
+        record.compensation = vector.compensation;
+        record.min = vector.min;
+        record.max = vector.max;
+        appendRaw(index, record);
+
+        std::string names = entry.first.substr(0, separator) + entry.first.substr(separator + 1);
+        names.resize(roundUp(names.size(), 8), '\0');
+        index.insert(index.end(), names.begin(), names.end());
+
+        for (size_t c = 0; c < vector.chunks.size(); c++) {
+            VectorStore::ChunkView view = VectorStore::viewOf(vector, c);
+            ChunkRecord chunk;
+            memset(&chunk, 0, sizeof(chunk));
+            chunk.offset = chunkOffset;
+            chunk.count = view.count;
+            chunk.sum = view.sum;
+            chunk.compensation = view.compensation;
+            chunk.min = view.min;
+            chunk.max = view.max;
+            appendRaw(index, chunk);
+            chunkOffset += chunkStride;
+        }
+    }
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.pageSize = static_cast<uint32_t>(pageSize);
+    header.chunkElements = static_cast<uint32_t>(Config::STORE_CHUNK_ELEMENTS);
+    header.vectorCount = vectorCount;
+    header.indexOffset = indexOffset;
+    header.indexBytes = index.size();
+    header.indexHash = ResultCache::hash(index.data(), index.size());
+    header.fileBytes = chunkOffset;
+
+    std::string tempPath = path + ".tmp";
+    bool written = pwriteAll(fd, &header, sizeof(header), 0) &&
+                   pwriteAll(fd, index.data(), index.size(), indexOffset);
+
+    // Данные блоков - прямо из памяти векторов или из старого снимка
+    chunkOffset = dataOffset;
+    for (const auto& entry : entries) {
+        const VectorStore::NamedVector& vector = *entry.second;
+        if (vector.dropped) {
+            continue;
+        }
+        for (size_t c = 0; written && c < vector.chunks.size(); c++) {
+            VectorStore::ChunkView view = VectorStore::viewOf(vector, c);
+            written = pwriteAll(fd, view.values, view.count * sizeof(double), chunkOffset);
+            chunkOffset += chunkStride;
+        }
+    }
+
+    // Неполный последний блок: длина файла задается явно
+    written = written && ftruncate(fd, static_cast<off_t>(header.fileBytes)) == 0 && fsync(fd) == 0;
+    if (close(fd) != 0 || !written || rename(tempPath.c_str(), path.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool StoreSnapshot::load(VectorStore& store, const std::string& path, size_t& vectors,
+                         std::string& error) {
+    vectors = 0;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(FileHeader)) {
+        close(fd);
+        error = "файл меньше заголовка";
+        return false;
+    }
+
+    // Отображение без чтения: страницы подгружаются по обращению
+    size_t fileSize = static_cast<size_t>(info.st_size);
+    void* base = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        error = strerror(errno);
+        return false;
+    }
+    std::shared_ptr<const void> mapping(base, [fileSize](const void* ptr) {
+        munmap(const_cast<void*>(ptr), fileSize);
+    });
+    const uint8_t* bytes = static_cast<const uint8_t*>(base);
+
+    FileHeader header;
+    memcpy(&header, bytes, sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != VERSION ||
+        header.chunkElements != Config::STORE_CHUNK_ELEMENTS || header.fileBytes != fileSize ||
+        header.pageSize == 0 || header.indexOffset > fileSize ||
+        header.indexBytes > fileSize - header.indexOffset ||
+        ResultCache::hash(bytes + header.indexOffset, header.indexBytes) != header.indexHash) {
+        error = "неверный заголовок или индекс";
+        return false;
+    }
+
+    // Индекс проверяется целиком до изменения хранилища
+    struct Loaded {
+        std::string login;
+        std::string key;
+        std::shared_ptr<VectorStore::NamedVector> vector;
+    };
+    std::vector<Loaded> loaded;
+    const uint8_t* ptr = bytes + header.indexOffset;
+    const uint8_t* end = ptr + header.indexBytes;
+
+    for (uint64_t v = 0; v < header.vectorCount; v++) {
+        VectorRecord record;
+        if (static_cast<size_t>(end - ptr) < sizeof(record)) {
+            error = "индекс обрезан";
+            return false;
+        }
+        memcpy(&record, ptr, sizeof(record));
+        ptr += sizeof(record);
+
+        size_t namesBytes = roundUp(record.loginLength + record.nameLength, 8);
+        uint64_t expectedChunks = (record.count + Config::STORE_CHUNK_ELEMENTS - 1) / Config::STORE_CHUNK_ELEMENTS;
+        if (static_cast<size_t>(end - ptr) < namesBytes || record.chunkCount < expectedChunks ||
+            static_cast<size_t>(end - ptr - namesBytes) / sizeof(ChunkRecord) < record.chunkCount) {
+            error = "некорректная запись вектора";
+            return false;
+        }
+
+        Loaded item;
+        item.login.assign(reinterpret_cast<const char*>(ptr), record.loginLength);
+        std::string name(reinterpret_cast<const char*>(ptr) + record.loginLength, record.nameLength);
+        ptr += namesBytes;
+        if (!VectorStore::isValidName(name) || item.login.find('\n') != std::string::npos) {
+            error = "некорректное имя вектора";
+            return false;
+        }
+        item.key = VectorStore::keyOf(item.login, name);
+
+        item.vector = std::make_shared<VectorStore::NamedVector>();
+        VectorStore::NamedVector& vector = *item.vector;
+        vector.count = record.count;
+        vector.sum = record.sum;
+        vector.compensation = record.compensation;
+        vector.min = record.min;
+        vector.max = record.max;
+        vector.mapping = mapping;
+        vector.chunks.resize(record.chunkCount);
+        vector.mapped.resize(record.chunkCount);
+
+        for (uint32_t c = 0; c < record.chunkCount; c++) {
+            ChunkRecord chunk;
+            memcpy(&chunk, ptr, sizeof(chunk));
+            ptr += sizeof(chunk);
+
+            // Блоки заполняются подряд: все полные, кроме последних
+            uint64_t before = static_cast<uint64_t>(c) * Config::STORE_CHUNK_ELEMENTS;
+            uint64_t expected = record.count > before ? record.count - before : 0;
+            if (expected > Config::STORE_CHUNK_ELEMENTS) {
+                expected = Config::STORE_CHUNK_ELEMENTS;
+            }
+            if (chunk.count != expected || chunk.offset % header.pageSize != 0 ||
+                chunk.offset > fileSize || chunk.count * sizeof(double) > fileSize - chunk.offset) {
+                error = "некорректный блок";
+                return false;
+            }
+
+            VectorStore::ChunkView& view = vector.mapped[c];
+            view.values = reinterpret_cast<const double*>(bytes + chunk.offset);
+            view.count = chunk.count;
+            view.sum = chunk.sum;
+            view.compensation = chunk.compensation;
+            view.min = chunk.min;
+            view.max = chunk.max;
+        }
+        loaded.push_back(std::move(item));
+    }
+
+    // Отображенные блоки учитываются в квоте так же, как блоки в памяти:
+    // после первой записи они станут обычными блоками
+    std::lock_guard<std::mutex> lock(store.storeMutex);
+    for (Loaded& item : loaded) {
+        size_t nameLength = item.key.size() - item.login.size() - 1;
+        store.loginUsage[item.login] += sizeof(VectorStore::NamedVector) + nameLength +
+                                        item.vector->chunks.size() * sizeof(VectorStore::Chunk);
+        store.vectors[item.key] = item.vector;
+    }
+    vectors = loaded.size();
+    return true;
+}
@@ -0,0 +1,103 @@
+#include "TlsContext.h"
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+namespace {
+    const long SELF_SIGNED_DAYS = 1;
+}
+
+TlsContext::TlsContext() : context(nullptr) {}
+
+TlsContext::~TlsContext() {
+    if (context != nullptr) {
+        SSL_CTX_free(context);
+    }
+}
+
+void TlsContext::setError(const std::string& what) {
+    char buffer[256] = {0};
+    unsigned long code = ERR_get_error();
+    if (code != 0) {
+        ERR_error_string_n(code, buffer, sizeof(buffer));
+    }
+    ERR_clear_error();
+    error = code != 0 ? what + ": " + buffer : what;
+}
+
+bool TlsContext::createContext(bool server) {
+    context = SSL_CTX_new(server ? TLS_server_method() : TLS_client_method());
+    if (context == nullptr) {
+        setError("SSL_CTX_new");
+        return false;
+    }
+
+    SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+    // Без пересогласования: запись никогда не ждет чтения
+    SSL_CTX_set_options(context, SSL_OP_ENABLE_KTLS | SSL_OP_NO_RENEGOTIATION);
+    // Очередь ответов отправляет остаток с другого адреса и частями
+    SSL_CTX_set_mode(context, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    // Шифры с AES-GCM ядро умеет; для TLS 1.3 они и так в начале списка
+    SSL_CTX_set_cipher_list(context, "ECDHE+AESGCM:ECDHE+CHACHA20");
+    return true;
+}
+
+bool TlsContext::loadCertificate(const std::string& certFile, const std::string& keyFile) {
+    if (!createContext(true)) {
+        return false;
+    }
+    if (SSL_CTX_use_certificate_chain_file(context, certFile.c_str()) != 1) {
+        setError("сертификат " + certFile);
+        return false;
+    }
+    if (SSL_CTX_use_PrivateKey_file(context, keyFile.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(context) != 1) {
+        setError("ключ " + keyFile);
+        return false;
+    }
+    return true;
+}
+
+bool TlsContext::generateSelfSigned() {
+    if (!createContext(true)) {
+        return false;
+    }
+
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* cert = X509_new();
+    bool done = key != nullptr && cert != nullptr;
+    if (done) {
+        X509_set_version(cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), SELF_SIGNED_DAYS * 24 * 3600);
+        X509_NAME* name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                   reinterpret_cast<const unsigned char*>("vcalc"), -1, -1, 0);
+        X509_set_issuer_name(cert, name);
+        done = X509_set_pubkey(cert, key) == 1 &&
+               X509_sign(cert, key, EVP_sha256()) > 0 &&
+               SSL_CTX_use_certificate(context, cert) == 1 &&
+               SSL_CTX_use_PrivateKey(context, key) == 1;
+    }
+    if (!done) {
+        setError("самоподписанный сертификат");
+    }
+
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return done;
+}
+
+bool TlsContext::initializeClient() {
+    if (!createContext(false)) {
+        return false;
+    }
+    SSL_CTX_set_verify(context, SSL_VERIFY_NONE, nullptr);
+    return true;
+}
+
+SSL* TlsContext::newSession() const {
+    return context != nullptr ? SSL_new(context) : nullptr;
+}
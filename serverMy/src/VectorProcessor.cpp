@@ -1,60 +1,85 @@
 #include "VectorProcessor.h"
+#include "Config.h"
 #include <cstring>
 #include <limits>
 #include <cmath>
 #include <iostream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#endif
 
-VectorProcessor::VectorResult VectorProcessor::processVectors(const std::vector<uint8_t>& binaryData) {
-    VectorResult result;
-    result.count = 0;
-    
-    size_t offset = 0;  // Используйте size_t здесь
-    size_t dataSize = binaryData.size();
-    
-    // Читаем количество векторов (4 байта, uint32_t)
-    uint32_t numVectors = 0;
-    if (!readUInt32(binaryData.data(), offset, dataSize, numVectors)) {
-        return result;
-    }
-    
-    result.count = numVectors;
-    
-    // Обрабатываем каждый вектор
-    for (uint32_t i = 0; i < numVectors; i++) {
-        // Читаем размер вектора
-        uint32_t vectorSize = 0;
-        if (!readUInt32(binaryData.data(), offset, dataSize, vectorSize)) {
-            return result;
-        }
+namespace {
+    VectorProcessor::TypedSum finishIntegerSum(int128_t sum, bool saturate) {
+        VectorProcessor::TypedSum result;
+        result.status = ResultStatus::OK;
         
-        // Читаем значения вектора
-        std::vector<double> vector;
-        vector.reserve(vectorSize);
+        const int128_t maxValue = std::numeric_limits<int64_t>::max();
+        const int128_t minValue = std::numeric_limits<int64_t>::min();
         
-        for (uint32_t j = 0; j < vectorSize; j++) {
-            double value = 0.0;
-            if (!readDouble(binaryData.data(), offset, dataSize, value)) {
+        if (sum > maxValue || sum < minValue) {
+            if (!saturate) {
+                result.status = ResultStatus::OVERFLOW;
+                result.integer = 0;
                 return result;
             }
-            vector.push_back(value);
+            sum = sum > maxValue ? maxValue : minValue;
         }
         
-        // Вычисляем сумму вектора
-        double sum = calculateVectorSum(vector);
-        result.sums.push_back(sum);
+        result.integer = static_cast<int64_t>(sum);
+        return result;
     }
     
-    return result;
+    void byteSwapScalar(uint8_t* data, size_t count, size_t elemSize) {
+        if (elemSize == sizeof(uint32_t)) {
+            for (size_t i = 0; i < count; i++) {
+                uint32_t v;
+                std::memcpy(&v, data + i * 4, 4);
+                v = __builtin_bswap32(v);
+                std::memcpy(data + i * 4, &v, 4);
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                uint64_t v;
+                std::memcpy(&v, data + i * 8, 8);
+                v = __builtin_bswap64(v);
+                std::memcpy(data + i * 8, &v, 8);
+            }
+        }
+    }
+    
+#if defined(__x86_64__) || defined(__i386__)
+    // 16 байт за одну перестановку pshufb; хвост - скалярно
+    __attribute__((target("ssse3")))
+    void byteSwapSsse3(uint8_t* data, size_t count, size_t elemSize) {
+        const __m128i mask = (elemSize == sizeof(uint32_t))
+            ? _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+            : _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+        
+        size_t bytes = count * elemSize;
+        size_t i = 0;
+        for (; i + 16 <= bytes; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_shuffle_epi8(v, mask));
+        }
+        byteSwapScalar(data + i, (bytes - i) / elemSize, elemSize);
+    }
+    
+    const bool hasSsse3 = __builtin_cpu_supports("ssse3");
+#endif
 }
 
 double VectorProcessor::calculateVectorSum(const std::vector<double>& vector) {
+    return calculateVectorSum(vector.data(), vector.size());
+}
+
+double VectorProcessor::calculateVectorSum(const double* data, size_t count) {
     double sum = 0.0;
     
     // Используем алгоритм Кэхэна для уменьшения ошибки округления
     double compensation = 0.0;
     
-    for (double value : vector) {
-        double y = value - compensation;
+    for (size_t i = 0; i < count; i++) {
+        double y = data[i] - compensation;
         double t = sum + y;
         compensation = (t - sum) - y;
         sum = t;
@@ -71,25 +96,187 @@ double VectorProcessor::calculateVectorSum(const std::vector<double>& vector) {
     return sum;
 }
 
-bool VectorProcessor::readUInt32(const uint8_t* data, size_t& offset, size_t maxSize, uint32_t& value) {
-    if (offset + sizeof(uint32_t) > maxSize) {
-        return false;
+ResultStatus VectorProcessor::checkVectorSize(uint32_t count, ElementType type) {
+    if (static_cast<size_t>(count) * elementSize(type) > Config::MAX_VECTOR_BYTES) {
+        return ResultStatus::OVERSIZE;
+    }
+    return ResultStatus::OK;
+}
+
+bool VectorProcessor::needsSwap(ByteOrder order) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return order == ByteOrder::LITTLE;
+#else
+    return order == ByteOrder::BIG;
+#endif
+}
+
+void VectorProcessor::toHostOrder(uint8_t* data, size_t count, size_t elemSize, ByteOrder order) {
+    if (!needsSwap(order)) {
+        return;
     }
     
-    // Предполагаем little-endian (как в большинстве систем)
-    std::memcpy(&value, data + offset, sizeof(uint32_t));
-    offset += sizeof(uint32_t);
+#if defined(__x86_64__) || defined(__i386__)
+    if (hasSsse3) {
+        byteSwapSsse3(data, count, elemSize);
+        return;
+    }
+#endif
+    byteSwapScalar(data, count, elemSize);
+}
+
+uint32_t VectorProcessor::toHostOrder32(uint32_t value, ByteOrder order) {
+    return needsSwap(order) ? __builtin_bswap32(value) : value;
+}
+
+bool VectorProcessor::isValidElementType(uint8_t type) {
+    return type >= static_cast<uint8_t>(ElementType::FLOAT32) &&
+           type <= static_cast<uint8_t>(ElementType::INT64);
+}
+
+bool VectorProcessor::isIntegerType(ElementType type) {
+    return type == ElementType::INT32 || type == ElementType::INT64;
+}
+
+size_t VectorProcessor::elementSize(ElementType type) {
+    switch (type) {
+        case ElementType::FLOAT32: return sizeof(float);
+        case ElementType::FLOAT64: return sizeof(double);
+        case ElementType::INT32: return sizeof(int32_t);
+        case ElementType::INT64: return sizeof(int64_t);
+        default: return 0;
+    }
+}
+
+// float32: накопление в double. 24 бита мантиссы против 53 - ошибка
+// округления пренебрежимо мала и без компенсации, а четыре независимых
+// аккумулятора дают компилятору векторизовать цикл
+template <>
+void VectorProcessor::accumulateElements<float>(SumState& state, const float* data, size_t count) {
+    double acc0 = state.lanes[0], acc1 = state.lanes[1];
+    double acc2 = state.lanes[2], acc3 = state.lanes[3];
+    size_t i = 0;
+    
+    for (; i + 4 <= count; i += 4) {
+        acc0 += data[i];
+        acc1 += data[i + 1];
+        acc2 += data[i + 2];
+        acc3 += data[i + 3];
+    }
+    for (; i < count; i++) {
+        acc0 += data[i];
+    }
+    
+    state.lanes[0] = acc0;
+    state.lanes[1] = acc1;
+    state.lanes[2] = acc2;
+    state.lanes[3] = acc3;
+}
+
+// float64: компенсированное суммирование Кэхэна, как в calculateVectorSum
+template <>
+void VectorProcessor::accumulateElements<double>(SumState& state, const double* data, size_t count) {
+    double sum = state.sum;
+    double compensation = state.compensation;
+    
+    for (size_t i = 0; i < count; i++) {
+        double y = data[i] - compensation;
+        double t = sum + y;
+        compensation = (t - sum) - y;
+        sum = t;
+    }
+    
+    state.sum = sum;
+    state.compensation = compensation;
+}
+
+// int32: внутри блока int64 не переполняется (|x| <= 2^31, n < 2^32)
+template <>
+void VectorProcessor::accumulateElements<int32_t>(SumState& state, const int32_t* data, size_t count) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += data[i];
+    }
+    state.integer += sum;
+}
+
+// int64: точная сумма в int128, проверка диапазона один раз в finishSum
+template <>
+void VectorProcessor::accumulateElements<int64_t>(SumState& state, const int64_t* data, size_t count) {
+    int128_t sum = state.integer;
+    for (size_t i = 0; i < count; i++) {
+        sum += data[i];
+    }
+    state.integer = sum;
+}
+
+void VectorProcessor::beginSum(SumState& state, ElementType type, bool exact) {
+    state.type = type;
+    state.exact = exact && !isIntegerType(type);
+    if (state.exact) {
+        state.exactSum.clear();
+    }
+    state.lanes[0] = state.lanes[1] = state.lanes[2] = state.lanes[3] = 0.0;
+    state.sum = 0.0;
+    state.compensation = 0.0;
+    state.integer = 0;
+}
+
+void VectorProcessor::accumulate(SumState& state, const uint8_t* data, size_t count) {
+    if (state.exact) {
+        if (state.type == ElementType::FLOAT32) {
+            state.exactSum.add(reinterpret_cast<const float*>(data), count);
+        } else {
+            state.exactSum.add(reinterpret_cast<const double*>(data), count);
+        }
+        return;
+    }
     
-    return true;
+    switch (state.type) {
+        case ElementType::FLOAT32:
+            accumulateElements(state, reinterpret_cast<const float*>(data), count);
+            break;
+        case ElementType::FLOAT64:
+            accumulateElements(state, reinterpret_cast<const double*>(data), count);
+            break;
+        case ElementType::INT32:
+            accumulateElements(state, reinterpret_cast<const int32_t*>(data), count);
+            break;
+        case ElementType::INT64:
+            accumulateElements(state, reinterpret_cast<const int64_t*>(data), count);
+            break;
+    }
 }
 
-bool VectorProcessor::readDouble(const uint8_t* data, size_t& offset, size_t maxSize, double& value) {
-    if (offset + sizeof(double) > maxSize) {
-        return false;
+VectorProcessor::TypedSum VectorProcessor::finishSum(const SumState& state, bool saturate) {
+    TypedSum result;
+    result.status = ResultStatus::OK;
+    
+    if (state.exact) {
+        result.real = state.exactSum.round();
+        return result;
     }
     
-    std::memcpy(&value, data + offset, sizeof(double));
-    offset += sizeof(double);
+    switch (state.type) {
+        case ElementType::FLOAT32:
+            result.real = (state.lanes[0] + state.lanes[1]) + (state.lanes[2] + state.lanes[3]);
+            break;
+        case ElementType::FLOAT64:
+            result.real = state.sum;
+            break;
+        case ElementType::INT32:
+        case ElementType::INT64:
+            result = finishIntegerSum(state.integer, saturate);
+            break;
+    }
     
-    return true;
+    return result;
+}
+
+VectorProcessor::TypedSum VectorProcessor::sumTyped(ElementType type, const uint8_t* data, 
+                                                    size_t count, bool saturate, bool exact) {
+    SumState state;
+    beginSum(state, type, exact);
+    accumulate(state, data, count);
+    return finishSum(state, saturate);
 }
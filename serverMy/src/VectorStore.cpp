@@ -0,0 +1,291 @@
+#include "VectorStore.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    // Сумма Ноймайера: в отличие от Кэхэна не теряет точность, когда
+    // слагаемое больше накопленной суммы (складываем суммы блоков)
+    inline void compensatedAdd(double& sum, double& compensation, double value) {
+        double t = sum + value;
+        if (std::fabs(sum) >= std::fabs(value)) {
+            compensation += (sum - t) + value;
+        } else {
+            compensation += (value - t) + sum;
+        }
+        sum = t;
+    }
+
+    const double EMPTY_MIN = std::numeric_limits<double>::infinity();
+    const double EMPTY_MAX = -std::numeric_limits<double>::infinity();
+}
+
+VectorStore::NamedVector::NamedVector()
+    : count(0), sum(0.0), compensation(0.0), min(EMPTY_MIN), max(EMPTY_MAX), dropped(false) {}
+
+VectorStore::VectorStore(size_t quotaBytes) : quotaBytes(quotaBytes) {}
+
+bool VectorStore::isStoreOp(uint8_t op) {
+    return op == Config::OP_CREATE || op == Config::OP_APPEND || op == Config::OP_UPDATE ||
+           op == Config::OP_QUERY || op == Config::OP_DROP;
+}
+
+bool VectorStore::isValidName(const std::string& name) {
+    if (name.empty() || name.size() > Config::STORE_MAX_NAME_LENGTH) {
+        return false;
+    }
+    for (char c : name) {
+        if (static_cast<unsigned char>(c) < 0x20) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string VectorStore::keyOf(const std::string& login, const std::string& name) {
+    // Управляющих символов нет ни в логине, ни в имени
+    return login + '\n' + name;
+}
+
+std::shared_ptr<VectorStore::NamedVector> VectorStore::find(const std::string& login,
+                                                           const std::string& name) {
+    std::lock_guard<std::mutex> lock(storeMutex);
+    auto it = vectors.find(keyOf(login, name));
+    return it == vectors.end() ? nullptr : it->second;
+}
+
+bool VectorStore::charge(const std::string& login, size_t bytes) {
+    std::lock_guard<std::mutex> lock(storeMutex);
+    size_t& used = loginUsage[login];
+    if (bytes > quotaBytes || used > quotaBytes - bytes) {
+        return false;
+    }
+    used += bytes;
+    return true;
+}
+
+void VectorStore::refund(const std::string& login, size_t bytes) {
+    std::lock_guard<std::mutex> lock(storeMutex);
+    auto it = loginUsage.find(login);
+    if (it == loginUsage.end()) {
+        return;
+    }
+    it->second = bytes > it->second ? 0 : it->second - bytes;
+    if (it->second == 0) {
+        loginUsage.erase(it);
+    }
+}
+
+size_t VectorStore::usage(const std::string& login) const {
+    std::lock_guard<std::mutex> lock(storeMutex);
+    auto it = loginUsage.find(login);
+    return it == loginUsage.end() ? 0 : it->second;
+}
+
+ResultStatus VectorStore::create(const std::string& login, const std::string& name) {
+    // Пустой вектор тоже занимает память - иначе квоту обходят числом имен
+    size_t overhead = sizeof(NamedVector) + name.size();
+    if (!charge(login, overhead)) {
+        return ResultStatus::QUOTA;
+    }
+
+    std::lock_guard<std::mutex> lock(storeMutex);
+    auto inserted = vectors.emplace(keyOf(login, name), nullptr);
+    if (!inserted.second) {
+        loginUsage[login] -= overhead;
+        return ResultStatus::EXISTS;
+    }
+    inserted.first->second = std::make_shared<NamedVector>();
+    return ResultStatus::OK;
+}
+
+ResultStatus VectorStore::drop(const std::string& login, const std::string& name) {
+    std::shared_ptr<NamedVector> vector;
+    {
+        std::lock_guard<std::mutex> lock(storeMutex);
+        auto it = vectors.find(keyOf(login, name));
+        if (it == vectors.end()) {
+            return ResultStatus::NOT_FOUND;
+        }
+        vector = it->second;
+        vectors.erase(it);
+    }
+
+    // Сессия, успевшая взять ссылку, увидит dropped и ничего не запишет
+    size_t bytes = sizeof(NamedVector) + name.size();
+    {
+        std::lock_guard<std::mutex> lock(vector->mutex);
+        bytes += vector->chunks.size() * sizeof(Chunk);
+        vector->chunks.clear();
+        vector->mapped.clear();
+        vector->mapping.reset();
+        vector->dropped = true;
+    }
+    refund(login, bytes);
+    return ResultStatus::OK;
+}
+
+ResultStatus VectorStore::append(const std::string& login, const std::string& name,
+                                 const double* values, size_t count, Aggregates& result) {
+    std::shared_ptr<NamedVector> vector = find(login, name);
+    if (!vector) {
+        return ResultStatus::NOT_FOUND;
+    }
+
+    std::lock_guard<std::mutex> lock(vector->mutex);
+    if (vector->dropped) {
+        return ResultStatus::NOT_FOUND;
+    }
+
+    // Новые блоки списываются с квоты заранее: либо весь пакет, либо ничего
+    const size_t chunkElements = Config::STORE_CHUNK_ELEMENTS;
+    size_t neededChunks = (vector->count + count + chunkElements - 1) / chunkElements;
+    size_t newChunks = neededChunks > vector->chunks.size() ? neededChunks - vector->chunks.size() : 0;
+    if (newChunks > 0 && !charge(login, newChunks * sizeof(Chunk))) {
+        return ResultStatus::QUOTA;
+    }
+    for (size_t i = 0; i < newChunks; i++) {
+        vector->chunks.emplace_back(new Chunk);
+        resetChunk(*vector->chunks.back());
+    }
+    vector->mapped.resize(vector->chunks.size());
+
+    for (size_t i = 0; i < count; i++) {
+        double value = values[i];
+        Chunk& chunk = writableChunk(*vector, vector->count / chunkElements);
+
+        chunk.values[chunk.count++] = value;
+        compensatedAdd(chunk.sum, chunk.compensation, value);
+        chunk.min = std::min(chunk.min, value);
+        chunk.max = std::max(chunk.max, value);
+
+        compensatedAdd(vector->sum, vector->compensation, value);
+        vector->min = std::min(vector->min, value);
+        vector->max = std::max(vector->max, value);
+        vector->count++;
+    }
+
+    fillAggregates(*vector, result);
+    return ResultStatus::OK;
+}
+
+ResultStatus VectorStore::update(const std::string& login, const std::string& name, uint64_t offset,
+                                 const double* values, size_t count, Aggregates& result) {
+    std::shared_ptr<NamedVector> vector = find(login, name);
+    if (!vector) {
+        return ResultStatus::NOT_FOUND;
+    }
+
+    std::lock_guard<std::mutex> lock(vector->mutex);
+    if (vector->dropped) {
+        return ResultStatus::NOT_FOUND;
+    }
+    if (offset > vector->count || count > vector->count - offset) {
+        return ResultStatus::OUT_OF_RANGE;
+    }
+
+    const size_t chunkElements = Config::STORE_CHUNK_ELEMENTS;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t index = offset + i;
+        writableChunk(*vector, index / chunkElements).values[index % chunkElements] = values[i];
+    }
+
+    // Пересчет затронутых блоков, итог - по агрегатам блоков, без обхода элементов
+    if (count > 0) {
+        size_t first = offset / chunkElements;
+        size_t last = (offset + count - 1) / chunkElements;
+        for (size_t c = first; c <= last; c++) {
+            recomputeChunk(writableChunk(*vector, c));
+        }
+        recomputeTotals(*vector);
+    }
+
+    fillAggregates(*vector, result);
+    return ResultStatus::OK;
+}
+
+ResultStatus VectorStore::query(const std::string& login, const std::string& name, Aggregates& result) {
+    std::shared_ptr<NamedVector> vector = find(login, name);
+    if (!vector) {
+        return ResultStatus::NOT_FOUND;
+    }
+
+    std::lock_guard<std::mutex> lock(vector->mutex);
+    if (vector->dropped) {
+        return ResultStatus::NOT_FOUND;
+    }
+
+    fillAggregates(*vector, result);
+    return ResultStatus::OK;
+}
+
+VectorStore::ChunkView VectorStore::viewOf(const NamedVector& vector, size_t index) {
+    const Chunk* chunk = vector.chunks[index].get();
+    if (chunk == nullptr) {
+        return vector.mapped[index];
+    }
+    return ChunkView{chunk->values, chunk->sum, chunk->compensation, chunk->min, chunk->max, chunk->count};
+}
+
+VectorStore::Chunk& VectorStore::writableChunk(NamedVector& vector, size_t index) {
+    // Страницы снимка читаются с диска только здесь - при первой записи в блок
+    if (!vector.chunks[index]) {
+        const ChunkView& view = vector.mapped[index];
+        Chunk* chunk = new Chunk;
+        memcpy(chunk->values, view.values, view.count * sizeof(double));
+        chunk->sum = view.sum;
+        chunk->compensation = view.compensation;
+        chunk->min = view.min;
+        chunk->max = view.max;
+        chunk->count = view.count;
+        vector.chunks[index].reset(chunk);
+    }
+    return *vector.chunks[index];
+}
+
+void VectorStore::resetChunk(Chunk& chunk) {
+    chunk.sum = 0.0;
+    chunk.compensation = 0.0;
+    chunk.min = EMPTY_MIN;
+    chunk.max = EMPTY_MAX;
+    chunk.count = 0;
+}
+
+void VectorStore::recomputeChunk(Chunk& chunk) {
+    uint32_t count = chunk.count;
+    resetChunk(chunk);
+    for (uint32_t i = 0; i < count; i++) {
+        double value = chunk.values[i];
+        compensatedAdd(chunk.sum, chunk.compensation, value);
+        chunk.min = std::min(chunk.min, value);
+        chunk.max = std::max(chunk.max, value);
+    }
+    chunk.count = count;
+}
+
+void VectorStore::recomputeTotals(NamedVector& vector) {
+    vector.sum = 0.0;
+    vector.compensation = 0.0;
+    vector.min = EMPTY_MIN;
+    vector.max = EMPTY_MAX;
+
+    for (size_t c = 0; c < vector.chunks.size(); c++) {
+        ChunkView chunk = viewOf(vector, c);
+        if (chunk.count == 0) {
+            continue;
+        }
+        compensatedAdd(vector.sum, vector.compensation, chunk.sum);
+        compensatedAdd(vector.sum, vector.compensation, chunk.compensation);
+        vector.min = std::min(vector.min, chunk.min);
+        vector.max = std::max(vector.max, chunk.max);
+    }
+}
+
+void VectorStore::fillAggregates(const NamedVector& vector, Aggregates& result) {
+    result.sum = vector.sum + vector.compensation;
+    result.count = vector.count;
+    // У пустого вектора минимума и максимума нет
+    result.min = vector.count ? vector.min : std::numeric_limits<double>::quiet_NaN();
+    result.max = vector.count ? vector.max : std::numeric_limits<double>::quiet_NaN();
+}
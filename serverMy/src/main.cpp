@@ -1,18 +1,11 @@
 #include <iostream>
 #include <csignal>
 #include <memory>
+#include <vector>
 #include "Server.h"
 #include "Config.h"
-
-std::unique_ptr<Server> server;
-
-void signalHandler(int signal) {
-    (void)signal;  // Явно указываем, что параметр не используется
-    if (server) {
-        std::cout << "\nПолучен сигнал завершения. Остановка сервера..." << std::endl;
-        server->stop();
-    }
-}
+#include "Benchmark.h"
+#include "NumaPlacement.h"
 
 void printHelp() {
     std::cout << "Векторный калькулятор сервер v1.0\n";
@@ -25,19 +18,75 @@ void printHelp() {
               << Config::DEFAULT_LOG_FILE << ")\n";
     std::cout << "  -p, --port PORT       Порт сервера (по умолчанию: " 
               << Config::DEFAULT_PORT << ")\n";
+    std::cout << "  --unix PATH           Дополнительно слушать Unix-сокет (клиенты на этом хосте,\n";
+    std::cout << "                        векторы через общую память)\n";
+    std::cout << "  --tls-port PORT       Дополнительно слушать порт с TLS (ядерный TLS, если доступен)\n";
+    std::cout << "  --tls-cert FILE       Сертификат TLS в PEM (цепочка)\n";
+    std::cout << "  --tls-key FILE        Закрытый ключ TLS в PEM\n";
+    std::cout << "  --max-connections N   Максимум одновременных подключений (по умолчанию: "
+              << Config::DEFAULT_MAX_CONNECTIONS << ")\n";
+    std::cout << "  --max-inflight-mb N   Бюджет векторных данных всех сессий, МБ (по умолчанию: "
+              << Config::DEFAULT_MAX_INFLIGHT_MB << ")\n";
+    std::cout << "  --max-per-login N     Максимум сессий одного логина (по умолчанию: "
+              << Config::DEFAULT_MAX_SESSIONS_PER_LOGIN << ")\n";
+    std::cout << "  --drain-timeout SEC   Сколько ждать активные сессии при остановке (по умолчанию: "
+              << Config::DEFAULT_DRAIN_TIMEOUT_SEC << ")\n";
+    std::cout << "  --handoff PATH        Управляющий Unix-сокет для обновления без простоя\n";
+    std::cout << "                        (SIGUSR2 запускает новый процесс с --takeover PATH)\n";
+    std::cout << "  --takeover PATH       Забрать слушающий сокет у процесса с --handoff PATH\n";
+    std::cout << "  --workers N           Потоков обработки сессий (по умолчанию: по числу CPU)\n";
+    std::cout << "  --cpus LIST           CPU для потоков сессий, например 0-7,16 (по умолчанию: все)\n";
+    std::cout << "  --acceptor-cpu N      Привязать поток приема подключений к CPU N\n";
+    std::cout << "  --numa                Размещать сессии и их буферы на NUMA-узлах\n";
+    std::cout << "  --result-cache N      Кэш сумм повторяющихся векторов на N записей (по умолчанию: выключен)\n";
+    std::cout << "  --store-quota-mb N    Квота именованных векторов на логин, МБ (по умолчанию: "
+              << Config::DEFAULT_STORE_QUOTA_MB << ", 0 - выключить)\n";
+    std::cout << "  --snapshot PATH       Файл снимка именованных векторов (загрузка при старте)\n";
+    std::cout << "  --snapshot-interval SEC  Период фонового снимка (по умолчанию: "
+              << Config::DEFAULT_SNAPSHOT_INTERVAL_SEC << ", 0 - только при остановке)\n";
+    std::cout << "  --trace-file PATH     Куда SIGUSR1 пишет последние этапы сессий, Chrome trace JSON\n";
+    std::cout << "                        (по умолчанию: " << Config::DEFAULT_TRACE_FILE_NAME
+              << " в каталоге журнала)\n";
+    std::cout << "  -b, --bench NAME      Запустить бенчмарк и выйти\n";
     std::cout << "\nПримеры:\n";
     std::cout << "  vcalc_server\n";
     std::cout << "  vcalc_server -c ./clients.conf -l ./vcalc.log -p 44444\n";
+    std::cout << "  vcalc_server --bench compression\n";
     std::cout << "\nТестовый клиент использует:\n";
     std::cout << "  Логин: user, Пароль: P@ssW0rd\n";
     std::cout << "  Адрес: 127.0.0.1, Порт: 33333\n";
 }
 
 int main(int argc, char* argv[]) {
+    // SIGINT/SIGTERM сервер читает через signalfd (см. Server::initialize);
+    // запись в оборванное соединение не должна убивать процесс - и в бенчмарках тоже
+    signal(SIGPIPE, SIG_IGN);
+    
     // Параметры по умолчанию
     std::string clientDbFile = Config::DEFAULT_CLIENT_DB;
     std::string logFile = Config::DEFAULT_LOG_FILE;
     int port = Config::DEFAULT_PORT;
+    int drainTimeout = Config::DEFAULT_DRAIN_TIMEOUT_SEC;
+    std::string handoffPath;
+    std::string unixPath;
+    int tlsPort = 0;
+    std::string tlsCertFile;
+    std::string tlsKeyFile;
+    std::string takeoverPath;
+    std::vector<int> workerCpus;
+    int acceptorCpu = -1;
+    size_t workerThreads = 0;
+    bool numaSteering = false;
+    size_t resultCacheEntries = 0;
+    size_t storeQuota = static_cast<size_t>(Config::DEFAULT_STORE_QUOTA_MB) * 1024 * 1024;
+    std::string snapshotPath;
+    int snapshotInterval = Config::DEFAULT_SNAPSHOT_INTERVAL_SEC;
+    std::string traceFile;  // пусто - рядом с журналом
+    
+    AdmissionController::Limits limits;
+    limits.maxConnections = Config::DEFAULT_MAX_CONNECTIONS;
+    limits.maxInflightBytes = static_cast<size_t>(Config::DEFAULT_MAX_INFLIGHT_MB) * 1024 * 1024;
+    limits.maxSessionsPerLogin = Config::DEFAULT_MAX_SESSIONS_PER_LOGIN;
     
     // Обработка аргументов командной строки
     for (int i = 1; i < argc; ++i) {
@@ -65,6 +114,143 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
         }
+        else if ((arg == "--max-connections" || arg == "--max-inflight-mb" || 
+                  arg == "--max-per-login") && i + 1 < argc) {
+            long value = 0;
+            try {
+                value = std::stol(argv[++i]);
+            } catch (const std::exception& e) {
+                value = 0;
+            }
+            if (value < 1) {
+                std::cerr << "Ошибка: " << arg << " должен быть положительным числом\n";
+                return 1;
+            }
+            
+            if (arg == "--max-connections") {
+                limits.maxConnections = static_cast<size_t>(value);
+            } else if (arg == "--max-inflight-mb") {
+                limits.maxInflightBytes = static_cast<size_t>(value) * 1024 * 1024;
+            } else {
+                limits.maxSessionsPerLogin = static_cast<size_t>(value);
+            }
+        }
+        else if (arg == "--drain-timeout" && i + 1 < argc) {
+            try {
+                drainTimeout = std::stoi(argv[++i]);
+            } catch (const std::exception& e) {
+                drainTimeout = -1;
+            }
+            if (drainTimeout < 0) {
+                std::cerr << "Ошибка: некорректное время ожидания сессий\n";
+                return 1;
+            }
+        }
+        else if (arg == "--unix" && i + 1 < argc) {
+            unixPath = argv[++i];
+        }
+        else if (arg == "--tls-port" && i + 1 < argc) {
+            try {
+                tlsPort = std::stoi(argv[++i]);
+            } catch (const std::exception& e) {
+                tlsPort = 0;
+            }
+            if (tlsPort < 1 || tlsPort > 65535) {
+                std::cerr << "Ошибка: порт TLS должен быть в диапазоне 1-65535\n";
+                return 1;
+            }
+        }
+        else if (arg == "--tls-cert" && i + 1 < argc) {
+            tlsCertFile = argv[++i];
+        }
+        else if (arg == "--tls-key" && i + 1 < argc) {
+            tlsKeyFile = argv[++i];
+        }
+        else if (arg == "--handoff" && i + 1 < argc) {
+            handoffPath = argv[++i];
+        }
+        else if (arg == "--takeover" && i + 1 < argc) {
+            takeoverPath = argv[++i];
+        }
+        else if (arg == "--cpus" && i + 1 < argc) {
+            if (!NumaPlacement::parseCpuList(argv[++i], workerCpus) || workerCpus.empty()) {
+                std::cerr << "Ошибка: некорректный список CPU\n";
+                return 1;
+            }
+        }
+        else if (arg == "--workers" && i + 1 < argc) {
+            long value = 0;
+            try {
+                value = std::stol(argv[++i]);
+            } catch (const std::exception& e) {
+                value = 0;
+            }
+            if (value < 1) {
+                std::cerr << "Ошибка: --workers должен быть положительным числом\n";
+                return 1;
+            }
+            workerThreads = static_cast<size_t>(value);
+        }
+        else if (arg == "--acceptor-cpu" && i + 1 < argc) {
+            try {
+                acceptorCpu = std::stoi(argv[++i]);
+            } catch (const std::exception& e) {
+                acceptorCpu = -1;
+            }
+            if (acceptorCpu < 0) {
+                std::cerr << "Ошибка: некорректный номер CPU\n";
+                return 1;
+            }
+        }
+        else if (arg == "--result-cache" && i + 1 < argc) {
+            long value = -1;
+            try {
+                value = std::stol(argv[++i]);
+            } catch (const std::exception& e) {
+                value = -1;
+            }
+            if (value < 0) {
+                std::cerr << "Ошибка: некорректный размер кэша результатов\n";
+                return 1;
+            }
+            resultCacheEntries = static_cast<size_t>(value);
+        }
+        else if (arg == "--store-quota-mb" && i + 1 < argc) {
+            long value = -1;
+            try {
+                value = std::stol(argv[++i]);
+            } catch (const std::exception& e) {
+                value = -1;
+            }
+            if (value < 0) {
+                std::cerr << "Ошибка: некорректная квота хранилища\n";
+                return 1;
+            }
+            storeQuota = static_cast<size_t>(value) * 1024 * 1024;
+        }
+        else if (arg == "--snapshot" && i + 1 < argc) {
+            snapshotPath = argv[++i];
+        }
+        else if (arg == "--snapshot-interval" && i + 1 < argc) {
+            try {
+                snapshotInterval = std::stoi(argv[++i]);
+            } catch (const std::exception& e) {
+                snapshotInterval = -1;
+            }
+            if (snapshotInterval < 0) {
+                std::cerr << "Ошибка: некорректный интервал снимков\n";
+                return 1;
+            }
+        }
+        else if (arg == "--trace-file" && i + 1 < argc) {
+            traceFile = argv[++i];
+        }
+        else if (arg == "--numa") {
+            numaSteering = true;
+        }
+        else if ((arg == "-b" || arg == "--bench") && i + 1 < argc) {
+            return Benchmark::run(argv[++i]);
+        }
         else {
             std::cerr << "Неизвестный параметр: " << arg << "\n";
             printHelp();
@@ -72,16 +258,17 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    if (tlsPort > 0 && (tlsCertFile.empty() || tlsKeyFile.empty())) {
+        std::cerr << "Ошибка: для --tls-port нужны --tls-cert и --tls-key\n";
+        return 1;
+    }
+    
     // Если запущен без параметров, показываем справку
     if (argc == 1) {
         printHelp();
         return 0;
     }
     
-    // Регистрация обработчиков сигналов
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
-    
     try {
         std::cout << "Запуск сервера...\n";
         std::cout << "Файл базы клиентов: " << clientDbFile << "\n";
@@ -89,7 +276,22 @@ int main(int argc, char* argv[]) {
         std::cout << "Порт: " << port << "\n";
         
         // Создание и запуск сервера
-        server = std::make_unique<Server>(port, clientDbFile, logFile);
+        auto server = std::make_unique<Server>(port, clientDbFile, logFile);
+        server->setAdmissionLimits(limits);
+        server->setDrainTimeout(drainTimeout);
+        server->setUnixPath(unixPath);
+        server->setTls(tlsPort, tlsCertFile, tlsKeyFile);
+        server->setHandoffPath(handoffPath);
+        server->setTakeoverPath(takeoverPath);
+        server->setUpgradeCommand(std::vector<std::string>(argv, argv + argc));
+        server->setCpuPlacement(workerCpus, acceptorCpu, numaSteering);
+        server->setWorkerThreads(workerThreads);
+        server->setResultCache(resultCacheEntries);
+        server->setStoreQuota(storeQuota);
+        server->setSnapshot(snapshotPath, snapshotInterval);
+        if (!traceFile.empty()) {
+            server->setTraceFile(traceFile);
+        }
         
         if (!server->initialize()) {
             std::cerr << "Ошибка инициализации сервера\n";
@@ -98,6 +300,8 @@ int main(int argc, char* argv[]) {
         
         std::cout << "Сервер запущен. Для остановки нажмите Ctrl+C\n";
         server->start();
+        
+        std::cout << "Получен сигнал завершения. Ожидание активных сессий...\n";
         server->waitForStop();
         
         std::cout << "Сервер остановлен.\n";